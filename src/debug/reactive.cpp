@@ -41,7 +41,15 @@ static VirtualTerminal _vt;
 Reactive::Reactive():
     LogLevel(LOG_LEVEL),
     LogHandlers(LOG_HANDLERS),
-    _cpuUsage(0)
+    _cpuUsage(0),
+    _numAlivePackets(0),
+    _packetBufferBytes(0),
+    _pendingAcceptClient(0),
+    _pendingCloseClient(0),
+    _numClients(0),
+    _outboundBytes(0),
+    _outboundReplaced(0),
+    _outboundOverflows(0)
 {
     initCPUDebugger();
     _lastUpdate = Server::get()->now();
@@ -64,6 +72,7 @@ void Reactive::onPacketWritten(uint16_t opcode)
 {
     IF_LOG(LOG_LEVEL_DEBUG, LOG_PACKET_LIFECYCLE)
     {
+        std::lock_guard<std::mutex> lock(_packetCountLock);
         ++_packetCount[opcode];
     }
 }
@@ -76,6 +85,7 @@ void Reactive::onPacketDestroyed(uint16_t opcode)
     {
         if (opcode)
         {
+            std::lock_guard<std::mutex> lock(_packetCountLock);
             --_packetCount[opcode];
         }
     }
@@ -167,12 +177,16 @@ void Reactive::update_impl(TimeBase heartBeat, TimeBase diff, TimeBase prevSleep
             Text(Style::Default(), " "),
             FlowLayout<>{
                 Text(Style::Default(), "Alive packets: "),
-                Text(Style::Default(), _numAlivePackets)
+                Text(Style::Default(), _numAlivePackets.load()),
+                Text(Style::Default(), " ("),
+                Text(Style::Default(), _packetBufferBytes / 1024),
+                Text(Style::Default(), "KB)")
             }
         });
 
     IF_LOG(LOG_LEVEL_DEBUG, LOG_PACKET_LIFECYCLE)
     {
+        std::lock_guard<std::mutex> lock(_packetCountLock);
         for (auto pair : _packetCount)
         {
             if (pair.second > 0)
@@ -194,11 +208,21 @@ void Reactive::update_impl(TimeBase heartBeat, TimeBase diff, TimeBase prevSleep
     component.children.emplace_back(
             FlowLayout<>{
                 Text(Style::Default(), "Clients (accepting/playing/closing): "),
-                Text(Style::Default(), _pendingAcceptClient),
+                Text(Style::Default(), _pendingAcceptClient.load()),
                 Text(Style::Default(), "/"),
-                Text(Style::Default(), _numClients),
+                Text(Style::Default(), _numClients.load()),
                 Text(Style::Default(), "/"),
-                Text(Style::Default(), _pendingCloseClient)
+                Text(Style::Default(), _pendingCloseClient.load())
+            });
+
+    component.children.emplace_back(
+            FlowLayout<>{
+                Text(Style::Default(), "Outbound (KB/replaced/overflows): "),
+                Text(Style::Default(), _outboundBytes / 1024),
+                Text(Style::Default(), "/"),
+                Text(Style::Default(), _outboundReplaced.load()),
+                Text(Style::Default(), "/"),
+                Text(Style::Default(), _outboundOverflows.load())
             });
 
     IF_LOG(LOG_LEVEL_DEBUG, LOG_CLIENT_LIFECYCLE)
@@ -213,7 +237,10 @@ void Reactive::update_impl(TimeBase heartBeat, TimeBase diff, TimeBase prevSleep
                         Text(Style::Default(), ","),
                         Text(Style::Default(), client->entity()->cell()->offset().r()),
                         Text(Style::Default(), "]: "),
-                        Text(Style::Default(), client->id())
+                        Text(Style::Default(), client->id()),
+                        Text(Style::Default(), " ("),
+                        Text(Style::Default(), client->outboundBytes()),
+                        Text(Style::Default(), " bytes queued)")
                     });
             }
         });
@@ -2,6 +2,7 @@
 
 #include "defs/common.hpp"
 
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <queue>
@@ -69,12 +70,20 @@ public:
     void onPacketCreated();
     void onPacketWritten(uint16_t opcode);
     void onPacketDestroyed(uint16_t opcode);
+    inline void onPacketBuffer(int32_t bytes) { _packetBufferBytes += bytes; }
 
     inline void onClientCreated() { ++_pendingAcceptClient; }
     inline void onClientAccepted() { ++_numClients; --_pendingAcceptClient; }
     inline void onClientClosed() { ++_pendingCloseClient; }
     inline void onClientDestroyed() { --_pendingCloseClient; --_numClients;}
 
+    // Client outbound queues, updated from any thread
+    inline void onOutboundQueued(uint32_t bytes) { _outboundBytes += bytes; }
+    inline void onOutboundReleased(uint32_t bytes) { _outboundBytes -= bytes; }
+    inline void onOutboundReplaced(uint32_t bytes) { _outboundBytes -= bytes; ++_outboundReplaced; }
+    inline void onOutboundOverflow() { ++_outboundOverflows; }
+    inline int64_t outboundBytes() { return _outboundBytes; }
+
     inline void onClusterUpdate(uint16_t numClusters, uint16_t numCells, uint16_t numStall, uint16_t numStallCandidates)
     {
         _numClusters = numClusters;
@@ -101,13 +110,20 @@ private:
     std::mutex _messagesLock;
     std::vector<std::string> _messages;
     
-    uint16_t _numAlivePackets;
+    // Updated from IO and pool threads
+    std::atomic<uint32_t> _numAlivePackets;
+    std::atomic<int64_t> _packetBufferBytes;
+    std::mutex _packetCountLock;
     std::unordered_map<uint16_t, uint16_t> _packetCount;
     
-    uint16_t _pendingAcceptClient;
-    uint16_t _pendingCloseClient;
-    uint16_t _numClients;
+    std::atomic<uint16_t> _pendingAcceptClient;
+    std::atomic<uint16_t> _pendingCloseClient;
+    std::atomic<uint16_t> _numClients;
     
+    std::atomic<int64_t> _outboundBytes;
+    std::atomic<uint32_t> _outboundReplaced;
+    std::atomic<uint32_t> _outboundOverflows;
+
     uint16_t _numClusters;
     uint16_t _numCells;
     uint16_t _numStall;
@@ -0,0 +1,6 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "defs/random.hpp"
+
+
+std::atomic<uint64_t> Random::_seed(0x5348494E5A554921ull);
@@ -0,0 +1,81 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <atomic>
+#include <limits>
+
+
+// Seeds generators from arbitrary (and possibly correlated) values
+inline uint64_t splitmix64(uint64_t* state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** generator, small enough to live on the stack
+// Satisfies UniformRandomBitGenerator, but prefer the helpers below to
+// standard distributions, whose output differs between standard libraries
+class Random
+{
+public:
+    using result_type = uint64_t;
+
+    explicit Random(uint64_t seed)
+    {
+        for (auto& s : _state)
+        {
+            s = splitmix64(&seed);
+        }
+    }
+
+    // Deterministic stream for an entity at a given tick, no matter which
+    // thread ends up updating it
+    static Random forEntity(uint64_t id, uint64_t tick)
+    {
+        uint64_t seed = _seed ^ (id * 0x9E3779B97F4A7C15ull);
+        seed = splitmix64(&seed) ^ tick;
+        return Random(seed);
+    }
+
+    // Global seed, same seed and inputs replay the same values
+    static inline uint64_t seed() { return _seed; }
+    static inline void seed(uint64_t seed) { _seed = seed; }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        uint64_t result = rotl(_state[1] * 5, 7) * 9;
+        uint64_t t = _state[1] << 17;
+
+        _state[2] ^= _state[0];
+        _state[3] ^= _state[1];
+        _state[1] ^= _state[2];
+        _state[0] ^= _state[3];
+        _state[2] ^= t;
+        _state[3] = rotl(_state[3], 45);
+
+        return result;
+    }
+
+    // Uniform in [0, 1), from the top 24 bits
+    inline float real() { return ((*this)() >> 40) * (1.0f / 16777216.0f); }
+    inline float uniform(float min, float max) { return min + (max - min) * real(); }
+    inline bool coin() { return ((*this)() >> 63) != 0; }
+
+private:
+    static inline uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+private:
+    uint64_t _state[4];
+
+    static std::atomic<uint64_t> _seed;
+};
@@ -33,6 +33,10 @@ public:
 		{
 			triggerError();
 		}
+		catch (const WriteOutOfBounds& e)
+		{
+			triggerError();
+		}
 
 		return false;
 	}
@@ -0,0 +1,211 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "io/bit_stream.hpp"
+#include "io/packet.hpp"
+#include "map/offset.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <glm/gtc/constants.hpp>
+INCL_WARN
+
+
+// Cell-relative positions lie at most this far from the cell center
+constexpr float CellPositionRange = std::max(cellSize_x, cellSize_y);
+
+static inline uint64_t mask(uint8_t bits)
+{
+    return bits >= 64 ? ~uint64_t{ 0 } : (uint64_t{ 1 } << bits) - 1;  // NOLINT(whitespace/braces)
+}
+
+uint64_t quantize(float value, float min, float max, uint8_t bits)
+{
+    float normalized = (std::min(std::max(value, min), max) - min) / (max - min);
+    return static_cast<uint64_t>(std::round(normalized * mask(bits)));
+}
+
+float dequantize(uint64_t value, float min, float max, uint8_t bits)
+{
+    return min + (max - min) * (static_cast<float>(value) / mask(bits));
+}
+
+
+BitWriter::BitWriter(Packet* packet) :
+    _packet(packet),
+    _scratch(0),
+    _pending(0),
+    _bits(0)
+{}
+
+BitWriter::~BitWriter()
+{
+    flush();
+}
+
+void BitWriter::write(uint64_t value, uint8_t bits)
+{
+    // Keep the scratch from overflowing
+    if (bits > 32)
+    {
+        write(value, 32);
+        write(value >> 32, bits - 32);
+        return;
+    }
+
+    _scratch |= (value & mask(bits)) << _pending;
+    _pending += bits;
+    _bits += bits;
+
+    if (_pending >= 8)
+    {
+        uint8_t count = _pending / 8;
+        uint8_t* out = _packet->claim(count);
+        for (uint8_t i = 0; i < count; ++i)
+        {
+            out[i] = static_cast<uint8_t>(_scratch);
+            _scratch >>= 8;
+        }
+        _pending -= count * 8;
+    }
+}
+
+void BitWriter::writeBool(bool value)
+{
+    write(value ? 1 : 0, 1);
+}
+
+void BitWriter::writeVarint(uint64_t value)
+{
+    do
+    {
+        uint64_t group = value & 0x7F;
+        value >>= 7;
+        write(group | (value ? 0x80 : 0x00), 8);
+    }
+    while (value);
+}
+
+void BitWriter::writeSigned(int64_t value)
+{
+    writeVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void BitWriter::writeQuantized(float value, float min, float max, uint8_t bits)
+{
+    write(quantize(value, min, max, bits), bits);
+}
+
+void BitWriter::writeAngle(float radians, uint8_t bits)
+{
+    // Wraps around, thus 2pi is the same step as 0
+    float turns = radians / glm::two_pi<float>();
+    turns -= std::floor(turns);
+    write(static_cast<uint64_t>(std::round(turns * (uint64_t{ 1 } << bits))), bits);  // NOLINT(whitespace/braces)
+}
+
+void BitWriter::writePosition(const glm::vec2& position, const glm::vec2& origin, float range, uint8_t bits)
+{
+    writeQuantized(position.x - origin.x, -range, range, bits);
+    writeQuantized(position.y - origin.y, -range, range, bits);
+}
+
+void BitWriter::writeCellPosition(const glm::vec2& position, uint8_t bits)
+{
+    auto offset = offsetOf(position.x, position.y);
+    writeSigned(offset.q());
+    writeSigned(offset.r());
+    writePosition(position, offset.center(), CellPositionRange, bits);
+}
+
+void BitWriter::flush()
+{
+    if (_pending > 0)
+    {
+        *_packet << static_cast<uint8_t>(_scratch);
+        _bits += 8 - _pending;
+        _scratch = 0;
+        _pending = 0;
+    }
+}
+
+
+BitReader::BitReader(Packet* packet) :
+    _packet(packet),
+    _scratch(0),
+    _pending(0)
+{}
+
+uint64_t BitReader::read(uint8_t bits)
+{
+    if (bits > 32)
+    {
+        uint64_t low = read(32);
+        return low | (read(bits - 32) << 32);
+    }
+
+    while (_pending < bits)
+    {
+        _scratch |= static_cast<uint64_t>(_packet->read<uint8_t>()) << _pending;
+        _pending += 8;
+    }
+
+    uint64_t value = _scratch & mask(bits);
+    _scratch >>= bits;
+    _pending -= bits;
+    return value;
+}
+
+bool BitReader::readBool()
+{
+    return read(1) != 0;
+}
+
+uint64_t BitReader::readVarint()
+{
+    uint64_t value = 0;
+    for (uint8_t shift = 0; shift < 64; shift += 7)
+    {
+        uint64_t group = read(8);
+        value |= (group & 0x7F) << shift;
+        if (!(group & 0x80))
+        {
+            break;
+        }
+    }
+
+    return value;
+}
+
+int64_t BitReader::readSigned()
+{
+    uint64_t value = readVarint();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+float BitReader::readQuantized(float min, float max, uint8_t bits)
+{
+    return dequantize(read(bits), min, max, bits);
+}
+
+float BitReader::readAngle(uint8_t bits)
+{
+    return static_cast<float>(read(bits)) / (uint64_t{ 1 } << bits) * glm::two_pi<float>();  // NOLINT(whitespace/braces)
+}
+
+glm::vec2 BitReader::readPosition(const glm::vec2& origin, float range, uint8_t bits)
+{
+    float x = readQuantized(-range, range, bits);
+    float y = readQuantized(-range, range, bits);
+    return origin + glm::vec2{ x, y };  // NOLINT(whitespace/braces)
+}
+
+glm::vec2 BitReader::readCellPosition(uint8_t bits)
+{
+    int32_t q = static_cast<int32_t>(readSigned());
+    int32_t r = static_cast<int32_t>(readSigned());
+    return readPosition(Offset(q, r).center(), CellPositionRange, bits);
+}
@@ -0,0 +1,91 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+class Packet;
+
+// Bits per component of quantized positions
+constexpr uint8_t DefaultPositionBits = 16;
+
+// Bits of quantized angles, about a third of a degree
+constexpr uint8_t DefaultAngleBits = 10;
+
+// Maps [min, max] onto `bits` bits, values out of range are clamped
+uint64_t quantize(float value, float min, float max, uint8_t bits);
+float dequantize(uint64_t value, float min, float max, uint8_t bits);
+
+
+// Packs values with arbitrary bit lengths into a packet
+// Bits are appended least significant first. The last byte is padded with
+// zeros on `flush`, after which the packet can be written to as usual.
+class BitWriter
+{
+public:
+    explicit BitWriter(Packet* packet);
+    BitWriter(const BitWriter& writer) = delete;
+    ~BitWriter();
+
+    void write(uint64_t value, uint8_t bits);
+    void writeBool(bool value);
+
+    // 7 bits per group plus a continuation bit, byte aligned it is LEB128
+    void writeVarint(uint64_t value);
+    // Zigzag encoded, small magnitudes take few bits regardless of sign
+    void writeSigned(int64_t value);
+
+    void writeQuantized(float value, float min, float max, uint8_t bits);
+    void writeAngle(float radians, uint8_t bits = DefaultAngleBits);
+
+    // Relative to `origin`, within `range` units in any direction
+    void writePosition(const glm::vec2& position, const glm::vec2& origin, float range, uint8_t bits = DefaultPositionBits);
+    // The cell, followed by the position relative to its center
+    void writeCellPosition(const glm::vec2& position, uint8_t bits = DefaultPositionBits);
+
+    void flush();
+
+    inline uint32_t bits() { return _bits; }
+
+private:
+    Packet* _packet;
+    uint64_t _scratch;
+    uint8_t _pending;
+    uint32_t _bits;
+};
+
+
+// Counterpart of BitWriter, reading from the packet read position
+// Whole bytes are consumed from the packet, thus once done with the bit
+// stream (ie. after the padding of a flushed writer) it can be read as usual.
+// Throws ReadOutOfBounds when running out of data.
+class BitReader
+{
+public:
+    explicit BitReader(Packet* packet);
+    BitReader(const BitReader& reader) = delete;
+
+    uint64_t read(uint8_t bits);
+    bool readBool();
+
+    uint64_t readVarint();
+    int64_t readSigned();
+
+    float readQuantized(float min, float max, uint8_t bits);
+    float readAngle(uint8_t bits = DefaultAngleBits);
+
+    glm::vec2 readPosition(const glm::vec2& origin, float range, uint8_t bits = DefaultPositionBits);
+    glm::vec2 readCellPosition(uint8_t bits = DefaultPositionBits);
+
+private:
+    Packet* _packet;
+    uint64_t _scratch;
+    uint8_t _pending;
+};
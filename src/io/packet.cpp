@@ -3,13 +3,22 @@
 #include "io/packet.hpp"
 #include "debug/debug.hpp"
 #include "debug/reactive.hpp"
+#include "io/thread_cached_pool.hpp"
+
+#include <string.h>
+
+#include "defs/common.hpp"
 
 
 Packet::Packet() :
     _read(0),
     _size(0),
     _write(0),
-    _refs(0)
+    _refs(0),
+    _data(nullptr),
+    _capacity(0),
+    _sizeClass(NoPacketSizeClass),
+    _framed(false)
 {
     Reactive::get()->onPacketCreated();
 }
@@ -27,6 +36,77 @@ Packet::~Packet()
         LOG(LOG_PACKET_LIFECYCLE, "Packet destroyed [EMPTY]");
         Reactive::get()->onPacketDestroyed(0x0);
     }
+
+    release();
+}
+
+template <uint8_t C> struct PacketBufferTag {};
+template <uint8_t C> using PacketBufferPool = ThreadCachedPool<PacketBufferTag<C>, PacketSizeClasses[C]>;
+
+uint8_t* Packet::allocate(uint8_t sizeClass)
+{
+    Reactive::get()->onPacketBuffer(PacketSizeClasses[sizeClass]);
+
+    switch (sizeClass)
+    {
+        case 0: return static_cast<uint8_t*>(PacketBufferPool<0>::malloc());
+        case 1: return static_cast<uint8_t*>(PacketBufferPool<1>::malloc());
+        case 2: return static_cast<uint8_t*>(PacketBufferPool<2>::malloc());
+        case 3: return static_cast<uint8_t*>(PacketBufferPool<3>::malloc());
+        default: return static_cast<uint8_t*>(PacketBufferPool<4>::malloc());
+    }
+}
+
+void Packet::deallocate(uint8_t sizeClass, uint8_t* buffer)
+{
+    Reactive::get()->onPacketBuffer(-static_cast<int32_t>(PacketSizeClasses[sizeClass]));
+
+    switch (sizeClass)
+    {
+        case 0: PacketBufferPool<0>::free(buffer); break;
+        case 1: PacketBufferPool<1>::free(buffer); break;
+        case 2: PacketBufferPool<2>::free(buffer); break;
+        case 3: PacketBufferPool<3>::free(buffer); break;
+        default: PacketBufferPool<4>::free(buffer); break;
+    }
+}
+
+void Packet::grow(std::size_t size)
+{
+    uint8_t sizeClass = 0;
+    while (sizeClass < NumPacketSizeClasses && PacketSizeClasses[sizeClass] < size)
+    {
+        ++sizeClass;
+    }
+
+    if (sizeClass == NumPacketSizeClasses)
+    {
+        throw WriteOutOfBounds();
+    }
+
+    // Views are copied, thus they stop depending on the external memory
+    uint8_t* buffer = allocate(sizeClass);
+    if (_data)
+    {
+        memcpy(buffer, _data, bufferLen());
+    }
+
+    release();
+    _data = buffer;
+    _capacity = PacketSizeClasses[sizeClass];
+    _sizeClass = sizeClass;
+}
+
+void Packet::release()
+{
+    if (_sizeClass != NoPacketSizeClass)
+    {
+        deallocate(_sizeClass, _data);
+        _sizeClass = NoPacketSizeClass;
+    }
+
+    _data = nullptr;
+    _capacity = 0;
 }
 
 
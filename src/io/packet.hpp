@@ -3,16 +3,19 @@
 #pragma once
 
 #include <inttypes.h>
+#include <string.h>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <exception>
+#include <string>
 
 #include "defs/common.hpp"
 #include "debug/reactive.hpp"
+#include "io/thread_cached_pool.hpp"
 
 INCL_NOWARN
 #include <boost/asio.hpp>
-#include <boost/pool/singleton_pool.hpp>
 #include <boost/intrusive_ptr.hpp>
 #include <glm/glm.hpp>
 INCL_WARN
@@ -26,6 +29,14 @@ struct ReadOutOfBounds : public std::exception
     }
 };
 
+struct WriteOutOfBounds : public std::exception
+{
+	const char* what() const noexcept
+    {
+    	return "Attempted write would go beyond the biggest packet size";
+    }
+};
+
 union f2u
 {
     float f;
@@ -34,25 +45,35 @@ union f2u
 
 class Packet;
 
+// Buffer size classes, packets move to the next one as they grow
+constexpr uint16_t PacketSizeClasses[] = { 64, 256, 1024, 4096, 16384 };  // NOLINT(whitespace/braces)
+constexpr uint8_t NumPacketSizeClasses = sizeof(PacketSizeClasses) / sizeof(PacketSizeClasses[0]);
+constexpr uint8_t NoPacketSizeClass = 0xFF;
+
 class Packet
 {
     friend inline void intrusive_ptr_add_ref(Packet* x);
     friend inline void intrusive_ptr_release(Packet* x);
 
 public:
+    // Biggest packet, header included
+    static constexpr uint16_t MaxSize = PacketSizeClasses[NumPacketSizeClasses - 1];
+
     virtual ~Packet();
 
     static Packet* create()
     {
-        void* mem = boost::singleton_pool<Packet, sizeof(Packet)>::malloc();
+        void* mem = ThreadCachedPool<Packet, sizeof(Packet)>::malloc();
         auto packet = new(mem) Packet();
         return packet;
     }
 
-    static Packet* create(uint16_t opcode)
+    // The hint is the expected payload size, not counting the header
+    static Packet* create(uint16_t opcode, uint16_t sizeHint = 0)
     {
-        void* mem = boost::singleton_pool<Packet, sizeof(Packet)>::malloc();
+        void* mem = ThreadCachedPool<Packet, sizeof(Packet)>::malloc();
         auto packet = new(mem) Packet();
+        packet->reserve(sizeof(uint16_t) * 2 + sizeHint);
         *packet << opcode;
         *packet << uint16_t{ 0x0000 };
         
@@ -63,9 +84,10 @@ public:
 
     static Packet* copy(Packet* from, uint16_t size)
     {
-        void* mem = boost::singleton_pool<Packet, sizeof(Packet)>::malloc();
+        void* mem = ThreadCachedPool<Packet, sizeof(Packet)>::malloc();
         auto packet = new(mem) Packet();
-        memcpy(packet->_buffer, from->_buffer, size);
+        packet->reserve(size);
+        memcpy(packet->_data, from->_data, size);
         packet->_size = size;
 
         if (size >= 2)
@@ -76,18 +98,36 @@ public:
         return packet;
     }
 
+    // Makes sure there is room for `size` bytes, might move to a bigger class
+    inline void reserve(std::size_t size)
+    {
+        if (size > _capacity)
+        {
+            grow(size);
+        }
+    }
+
+    // Reserves `size` bytes at the write position and skips them
+    // Callers fill them in bulk, see PacketSchema
+    inline uint8_t* claim(uint16_t size)
+    {
+        reserve(_write + size);
+        uint8_t* out = _data + _write;
+        _write += size;
+        return out;
+    }
+
     template <typename T>
     Packet& operator<<(T v)
     {
-        *reinterpret_cast<T*>(_buffer + _write) = v;
-        _write += sizeof(T);
+        memcpy(claim(sizeof(T)), &v, sizeof(T));
         return *this;
     }
 
     Packet& operator<<(float v)
     {
-        *reinterpret_cast<uint32_t*>(_buffer + _write) = f2u{ v }.u;  // NOLINT(whitespace/braces)
-        _write += sizeof(uint32_t);
+        uint32_t u = f2u{ v }.u;  // NOLINT(whitespace/braces)
+        memcpy(claim(sizeof(uint32_t)), &u, sizeof(uint32_t));
         return *this;
     }
 
@@ -109,13 +149,9 @@ public:
     Packet& operator<<(const std::string& str)
     {
         uint16_t length = str.length();
-        *this << length;
-
-        for (uint16_t i = 0; i < length; ++i)
-        {
-            *this << (uint8_t)str[i];
-        }
-
+        uint8_t* out = claim(sizeof(uint16_t) + length);
+        memcpy(out, &length, sizeof(uint16_t));
+        memcpy(out + sizeof(uint16_t), str.data(), length);
         return *this;
     }
 
@@ -125,9 +161,9 @@ public:
                                             packet->size(),
                                             packet->written() });  // NOLINT(whitespace/braces)
 
-        for (uint16_t i = 4; i < end; ++i)
+        if (end > 4)
         {
-            *this << packet->data()[i];
+            memcpy(claim(end - 4), packet->data() + 4, end - 4);
         }
 
         return *this;
@@ -145,8 +181,10 @@ public:
         {
             throw ReadOutOfBounds();
         }
-        
-        return *reinterpret_cast<T*>(_buffer + offset);
+
+        T v;
+        memcpy(&v, _data + offset, sizeof(T));
+        return v;
     }
 
     template <typename T>
@@ -164,45 +202,98 @@ public:
             throw ReadOutOfBounds();
         }
 
-        void* buffer = reinterpret_cast<void*>(_buffer + _read);
+        void* buffer = reinterpret_cast<void*>(_data + _read);
         _read += length;
         return buffer;
     }
 
     inline void reset() { _read = _write = _size = 0; }
 
+    // Drops everything written past `size`
+    inline void truncate(uint16_t size) { _write = std::min(_write, size); }
+
+    // Points the packet to external memory (ie. a receive buffer), read-only
+    // The memory is not owned, it must outlive any use of the packet
+    inline void view(uint8_t* data, uint16_t size)
+    {
+        release();
+        _data = data;
+        _capacity = 0;
+        _read = _write = 0;
+        _size = size;
+    }
+
     inline uint16_t bufferLen() { return std::max(_size, _write); }
     inline uint16_t size() { return _size; }
     inline uint16_t totalRead() { return _read; }
     inline uint16_t written() { return _write; }
 
-    inline uint8_t* data() { return _buffer; }
+    inline uint8_t* data() { return _data; }
+
+    // Sets the header length, once nothing else will be written
+    // Must happen before the packet is shared, afterwards it only reads it
+    inline void finalize()
+    {
+        if (_framed || _write < sizeof(uint16_t) * 2)
+        {
+            return;
+        }
+
+        uint16_t length = _write - sizeof(uint16_t) * 2;
+        if (memcmp(_data + sizeof(uint16_t), &length, sizeof(uint16_t)) != 0)
+        {
+            memcpy(_data + sizeof(uint16_t), &length, sizeof(uint16_t));
+        }
+    }
+
     inline boost::asio::mutable_buffers_1 sendBuffer()
     {
-        *reinterpret_cast<uint16_t*>(_buffer + sizeof(uint16_t)) = _write - sizeof(uint16_t) * 2;
-        return boost::asio::buffer(_buffer, _write);
+        finalize();
+        return boost::asio::buffer(_data, _write);
+    }
+
+    // Holds several complete frames back to back, their lengths already set
+    inline bool framed() { return _framed; }
+    inline void framed(bool framed) { _framed = framed; }
+    inline boost::asio::mutable_buffers_1 recvBuffer(uint16_t len)
+    {
+        reserve(_size + len);
+        return boost::asio::buffer(_data + _size, len);
     }
-    inline boost::asio::mutable_buffers_1 recvBuffer(uint16_t len) { return boost::asio::buffer(_buffer + _size, len); }
     inline void addSize(uint16_t offset) { _size += offset; }
 
-    // TODO(gpascualg): It seems boost:object_pool is not thread-safe, but boost::singleton_pool is. Check it up again
-    inline void destroy() 
+    // Might be called from any thread, the memory goes to its local cache
+    inline void destroy()
     {
         this->~Packet();
-        boost::singleton_pool<Packet, sizeof(Packet)>::free(static_cast<void*>(this)); 
+        ThreadCachedPool<Packet, sizeof(Packet)>::free(static_cast<void*>(this));
     }
 
+    inline uint16_t capacity() { return _capacity; }
+
 private:
     Packet();
 
+    void grow(std::size_t size);
+    void release();
+
+    static uint8_t* allocate(uint8_t sizeClass);
+    static void deallocate(uint8_t sizeClass, uint8_t* buffer);
+
 private:
     uint16_t _read;
     uint16_t _size;
     uint16_t _write;
-    uint16_t _refs;
-    uint8_t _buffer[1024];
+    std::atomic<uint16_t> _refs;
+
+    // Pooled buffer, unless it is a view (in which case there is no class)
+    uint8_t* _data;
+    uint16_t _capacity;
+    uint8_t _sizeClass;
+    bool _framed;
 };
 
 template <> float Packet::read();
 template <> glm::vec2 Packet::read();
 template <> glm::vec3 Packet::read();
+template <> std::string Packet::read();
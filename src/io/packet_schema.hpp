@@ -0,0 +1,135 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include "io/packet.hpp"
+
+#include <inttypes.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+// Wire layout of a fixed-size field
+// Specializations provide `Size`, `write(out, v)` and `read(in, v)`, both
+// returning the pointer past the field. Bounds are checked by the caller.
+template <typename T, typename = void>
+struct WireField;
+
+template <typename T>
+struct WireField<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static constexpr uint16_t Size = sizeof(T);
+
+    static inline uint8_t* write(uint8_t* out, const T& v)
+    {
+        memcpy(out, &v, sizeof(T));
+        return out + sizeof(T);
+    }
+
+    static inline const uint8_t* read(const uint8_t* in, T& v)
+    {
+        memcpy(&v, in, sizeof(T));
+        return in + sizeof(T);
+    }
+};
+
+template <>
+struct WireField<glm::vec2>
+{
+    static constexpr uint16_t Size = sizeof(float) * 2;
+
+    static inline uint8_t* write(uint8_t* out, const glm::vec2& v)
+    {
+        out = WireField<float>::write(out, v.x);
+        return WireField<float>::write(out, v.y);
+    }
+
+    static inline const uint8_t* read(const uint8_t* in, glm::vec2& v)
+    {
+        in = WireField<float>::read(in, v.x);
+        return WireField<float>::read(in, v.y);
+    }
+};
+
+template <>
+struct WireField<glm::vec3>
+{
+    static constexpr uint16_t Size = sizeof(float) * 3;
+
+    static inline uint8_t* write(uint8_t* out, const glm::vec3& v)
+    {
+        out = WireField<float>::write(out, v.x);
+        out = WireField<float>::write(out, v.y);
+        return WireField<float>::write(out, v.z);
+    }
+
+    static inline const uint8_t* read(const uint8_t* in, glm::vec3& v)
+    {
+        in = WireField<float>::read(in, v.x);
+        in = WireField<float>::read(in, v.y);
+        return WireField<float>::read(in, v.z);
+    }
+};
+
+
+template <typename... Fields>
+struct WireSize;
+
+template <>
+struct WireSize<>
+{
+    static constexpr uint16_t value = 0;
+};
+
+template <typename T, typename... Rest>
+struct WireSize<T, Rest...>
+{
+    static constexpr uint16_t value = WireField<T>::Size + WireSize<Rest...>::value;
+};
+
+
+// Fixed part of a packet, declared once
+//  using SpeedChange = PacketSchema<uint64_t, uint8_t, glm::vec2>;
+//  SpeedChange::write(packet, id, speed, start);
+// Writing reserves all fields at once and reading checks bounds only once,
+// variable-sized data (strings, lists) can follow with the usual operators.
+template <typename... Fields>
+struct PacketSchema
+{
+    static constexpr uint16_t Size = WireSize<Fields...>::value;
+
+    static Packet* create(uint16_t opcode, const Fields&... fields)
+    {
+        Packet* packet = Packet::create(opcode, Size);
+        write(packet, fields...);
+        return packet;
+    }
+
+    static void write(Packet* packet, const Fields&... fields)
+    {
+        uint8_t* out = packet->claim(Size);
+
+        // Braced initializers are evaluated in order
+        int unused[] = { 0, (out = WireField<Fields>::write(out, fields), 0)... };  // NOLINT(whitespace/braces)
+        (void)unused;
+    }
+
+    // Throws ReadOutOfBounds, without consuming anything, if the packet is too short
+    static void read(Packet* packet, Fields&... fields)
+    {
+        const uint8_t* in = static_cast<const uint8_t*>(packet->read(Size));
+
+        int unused[] = { 0, (in = WireField<Fields>::read(in, fields), 0)... };  // NOLINT(whitespace/braces)
+        (void)unused;
+    }
+};
+
+template <typename... Fields>
+constexpr uint16_t PacketSchema<Fields...>::Size;
@@ -0,0 +1,140 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <boost/pool/singleton_pool.hpp>
+INCL_WARN
+
+
+// Chunks moved at once between a thread cache and the shared depot
+constexpr std::size_t PoolCacheBatch = 32;
+
+// Fixed-size allocator with a free-list per thread
+// Allocations and frees only touch the calling thread cache. Caches exchange
+// whole batches with a shared depot, thus the mutex is taken once every
+// PoolCacheBatch operations at most, no matter which thread frees a chunk.
+// Memory is never returned to the system, same as boost::singleton_pool.
+template <typename Tag, std::size_t Size>
+class ThreadCachedPool
+{
+    static_assert(Size >= sizeof(void*), "Chunks must be able to hold a pointer");
+
+private:
+    struct Node
+    {
+        Node* next;
+    };
+
+    using Batch = std::pair<Node*, std::size_t>;
+
+    struct Cache
+    {
+        Node* head = nullptr;
+        std::size_t count = 0;
+
+        ~Cache()
+        {
+            // Hand everything over, other threads might still use it
+            if (head)
+            {
+                ThreadCachedPool::depot(Batch { head, count });  // NOLINT(whitespace/braces)
+            }
+        }
+    };
+
+public:
+    static void* malloc()
+    {
+        Cache& local = cache();
+        if (!local.head)
+        {
+            refill(local);
+        }
+
+        Node* node = local.head;
+        local.head = node->next;
+        --local.count;
+        return node;
+    }
+
+    static void free(void* ptr)
+    {
+        Cache& local = cache();
+        Node* node = static_cast<Node*>(ptr);
+        node->next = local.head;
+        local.head = node;
+
+        // Keep one batch around, give the other back
+        if (++local.count >= PoolCacheBatch * 2)
+        {
+            Node* batch = local.head;
+            Node* last = batch;
+            for (std::size_t i = 1; i < PoolCacheBatch; ++i)
+            {
+                last = last->next;
+            }
+
+            local.head = last->next;
+            local.count -= PoolCacheBatch;
+            last->next = nullptr;
+
+            depot(Batch { batch, PoolCacheBatch });  // NOLINT(whitespace/braces)
+        }
+    }
+
+private:
+    static Cache& cache()
+    {
+        static thread_local Cache local;
+        return local;
+    }
+
+    static void depot(Batch batch)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _depot.push_back(batch);
+    }
+
+    static void refill(Cache& local)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_depot.empty())
+            {
+                local.head = _depot.back().first;
+                local.count = _depot.back().second;
+                _depot.pop_back();
+                return;
+            }
+        }
+
+        // Depot is empty, carve a new batch
+        for (std::size_t i = 0; i < PoolCacheBatch; ++i)
+        {
+            Node* node = static_cast<Node*>(boost::singleton_pool<Tag, Size>::malloc());
+            node->next = local.head;
+            local.head = node;
+        }
+
+        local.count = PoolCacheBatch;
+    }
+
+private:
+    static std::mutex _mutex;
+    static std::vector<Batch> _depot;
+};
+
+
+template <typename Tag, std::size_t Size>
+std::mutex ThreadCachedPool<Tag, Size>::_mutex;
+
+template <typename Tag, std::size_t Size>
+std::vector<typename ThreadCachedPool<Tag, Size>::Batch> ThreadCachedPool<Tag, Size>::_depot;
@@ -8,10 +8,12 @@
 #include "map/map_aware_entity.hpp"
 #include "map/offset.hpp"
 #include "map/quadtree.hpp"
+#include "io/packet.hpp"
 #include "movement/motion_master.hpp"
 #include "physics/bounding_box.hpp"
 #include "server/server.hpp"
 
+#include <string.h>
 #include <algorithm>
 #include <array>
 #include <list>
@@ -28,6 +30,7 @@ Cell::Cell(Map* map, const Offset& offset) :
     LOG(LOG_CELLS, "Created (%4d, %4d, %4d)", _offset.q(), _offset.r(), _offset.s());
 
     _broadcast = &_broadcastQueue1;
+    _spawnCache.valid = false;
     _quadTree = new RadialQuadTree<MaxQuadrantEntities, MaxQuadtreeDepth>(offset.center(), cellSize_x + 10);
 
     Server::get()->onCellCreated(this);
@@ -88,27 +91,21 @@ std::vector<Cell*> Cell::inRadius(uint16_t radius)
 
 void Cell::update(uint64_t elapsed)
 {
-    auto& currentQueue = *_broadcast;
+    // Queued broadcasts are left for the fan-out stage
     _broadcast = _broadcast == &_broadcastQueue1 ? &_broadcastQueue2 : &_broadcastQueue1;
 
     // Update players
     for (auto pair : _entities)
     {
-        auto updater = pair.second;
-        auto client = updater->client();
-        updater->update(elapsed);
-
-        // If there is any packet, broadcast it!
-        if (client)
-        {
-            for (auto packet : currentQueue)
-            {
-                client->send(packet);
-            }
-        }
+        pair.second->update(elapsed);
+    }
+}
 
-        // Process map on spawn packets
-        processRequests(updater);
+void Cell::settle()
+{
+    for (auto pair : _entities)
+    {
+        auto updater = pair.second;
 
         // Insert into quadtree
         _quadTree->insert(updater);
@@ -122,6 +119,9 @@ void Cell::update(uint64_t elapsed)
             }
         }
     }
+
+    // Once everything is up to date, serve spawn/despawn requests
+    processRequests();
 }
 
 void Cell::physics(uint64_t elapsed)
@@ -162,49 +162,278 @@ void Cell::cleanup(uint64_t elapsed)
 void Cell::addEntity(MapAwareEntity* entity)
 {
     _entities.emplace(entity->id(), entity);
-    
-    if (entity->client())
-    {
-        ++_clientsCount;
-    }
+    _spawnCache.valid = false;
 }
 
 void Cell::removeEntity(MapAwareEntity* entity)
 {
     _entities.erase(entity->id());
+    _spawnCache.valid = false;
+    _spawnCache.entries.erase(entity->id());
+}
+
+// TODO: If player spawns at the same time as a mob, a double spawn is sent
 
-    if (entity->client())
+void Cell::processRequests()
+{
+    for (auto request : _requests)
     {
-        --_clientsCount;
+        auto client = request.who->client();
+
+        if (request.type == RequestType::SPAWN)
+        {
+            LOG(LOG_SPAWNS, "(%d, %d) Serving SPAWN request from %" PRId64, offset().q(), offset().r(), request.who->id());
+
+            // Requester is here too, it must not spawn itself
+            if (request.who->cell() == this)
+            {
+                for (auto& packet : serialize(RequestType::SPAWN, request.who))
+                {
+                    client->send(packet);
+                }
+            }
+            else
+            {
+                for (auto& packet : spawnCache().packets)
+                {
+                    client->send(packet);
+                }
+            }
+        }
+        else if (request.type == RequestType::DESPAWN)
+        {
+            LOG(LOG_SPAWNS, "(%d, %d) Serving DESPAWN request from %" PRId64, offset().q(), offset().r(), request.who->id());
+
+            for (auto& packet : serialize(RequestType::DESPAWN, request.who))
+            {
+                client->send(packet);
+            }
+        }
     }
 }
 
-// TODO: If player spawns at the same time as a mob, a double spawn is sent
+const Cell::SpawnCache& Cell::spawnCache()
+{
+    uint64_t tick = Server::get()->tick();
+
+    // Entities mark their fields dirty whenever they change, changes in the
+    // very tick it was built might have come after it
+    if (_spawnCache.valid && _spawnCache.tick != tick)
+    {
+        uint64_t since = _spawnCache.tick > 0 ? _spawnCache.tick - 1 : 0;
+        for (auto pair : _entities)
+        {
+            if (pair.second->changedSince(since))
+            {
+                _spawnCache.valid = false;
+                break;
+            }
+        }
+    }
 
-void Cell::processRequests(MapAwareEntity* entity)
+    if (!_spawnCache.valid)
+    {
+        _spawnCache.valid = true;
+        _spawnCache.tick = tick;
+        _spawnCache.packets = serialize(RequestType::SPAWN, nullptr, &_spawnCache);
+    }
+
+    return _spawnCache;
+}
+
+// Appends id, payload length and payload, false if the entity does not
+// write into lists. Throws WriteOutOfBounds if it does not fit, in which
+// case nothing is left written either
+static bool writeEntry(Packet* list, MapAwareEntity* entity, bool spawn)
 {
-    for (auto request : _requests)
+    uint16_t begin = list->written();
+
+    try
+    {
+        *list << entity->id() << uint16_t{ 0 };  // NOLINT(whitespace/braces)
+        if (!(spawn ? entity->writeSpawn(list) : entity->writeDespawn(list)))
+        {
+            list->truncate(begin);
+            return false;
+        }
+    }
+    catch (const WriteOutOfBounds&)
+    {
+        list->truncate(begin);
+        throw;
+    }
+
+    uint16_t length = list->written() - begin - sizeof(uint64_t) - sizeof(uint16_t);
+    memcpy(list->data() + begin + sizeof(uint64_t), &length, sizeof(uint16_t));
+    return true;
+}
+
+std::vector<boost::intrusive_ptr<Packet>> Cell::serialize(RequestType type, MapAwareEntity* exclude, SpawnCache* cache)
+{
+    bool spawn = type == RequestType::SPAWN;
+    uint64_t tick = Server::get()->tick();
+
+    std::vector<boost::intrusive_ptr<Packet>> packets;
+    Packet* list = nullptr;
+    Packet* frames = nullptr;
+    uint16_t count = 0;
+
+    auto openList = [&]()
+        {
+            list = Packet::create(spawn ? SpawnListOpcode : DespawnListOpcode);
+            *list << uint16_t{ 0 };  // NOLINT(whitespace/braces)
+            packets.push_back(list);
+            count = 0;
+        };  // NOLINT(whitespace/braces)
+
+    auto closeEntry = [&]()
+        {
+            ++count;
+            memcpy(list->data() + sizeof(uint16_t) * 2, &count, sizeof(uint16_t));
+
+            if (list->written() >= MaxEntityListBytes)
+            {
+                list = nullptr;
+            }
+        };  // NOLINT(whitespace/braces)
+
+    auto appendFrame = [&](const uint8_t* data, uint16_t size)
+        {
+            if (!frames || frames->written() + size > Packet::MaxSize)
+            {
+                frames = Packet::create();
+                frames->framed(true);
+                packets.push_back(frames);
+            }
+
+            memcpy(frames->claim(size), data, size);
+        };  // NOLINT(whitespace/braces)
+
+    for (auto pair : _entities)
     {
-        if (request.who != entity)
+        auto entity = pair.second;
+        if (entity == exclude)
+        {
+            continue;
+        }
+
+        // Unchanged entities copy what they wrote last time, changes in the
+        // very tick it was written might have come after it
+        SpawnEntry* entry = cache ? &cache->entries[entity->id()] : nullptr;
+        if (entry && entry->valid && !entity->changedSince(entry->tick > 0 ? entry->tick - 1 : 0))
         {
-            if (request.type == RequestType::SPAWN)
+            uint16_t size = static_cast<uint16_t>(entry->bytes.size());
+            if (size == 0)
             {
-                LOG(LOG_SPAWNS, "(%d, %d) Serving SPAWN request from %" PRId64 " with entity %" PRId64, offset().q(), offset().r(), request.who->id(), entity->id());
+                continue;
+            }
 
-                // 0x0AAx are reserved packets
-                auto packet = entity->spawnPacket();
-                request.who->client()->send(packet);
+            if (!entry->listed)
+            {
+                appendFrame(entry->bytes.data(), size);
+                continue;
             }
-            else if (request.type == RequestType::DESPAWN)
+
+            if (list && list->written() + size > Packet::MaxSize)
             {
-                LOG(LOG_SPAWNS, "(%d, %d) Serving DESPAWN request from %" PRId64 " with entity %" PRId64, offset().q(), offset().r(), request.who->id(), entity->id());
+                list = nullptr;
+            }
 
-                // 0x0AAx are reserved packets
-                auto packet = entity->despawnPacket();
-                request.who->client()->send(packet);
+            if (!list)
+            {
+                openList();
             }
+
+            memcpy(list->claim(size), entry->bytes.data(), size);
+            closeEntry();
+            continue;
         }
+
+        if (entry)
+        {
+            entry->valid = true;
+            entry->listed = true;
+            entry->tick = tick;
+            entry->bytes.clear();
+        }
+
+        bool written = false;
+        bool fits = true;
+        uint16_t begin = 0;
+        for (int attempt = 0; attempt < 2 && fits; ++attempt)
+        {
+            if (!list)
+            {
+                openList();
+            }
+
+            try
+            {
+                begin = list->written();
+                written = writeEntry(list, entity, spawn);
+                break;
+            }
+            catch (const WriteOutOfBounds&)
+            {
+                // Goes first in a new list, unless it already was
+                fits = count > 0;
+                list = fits ? nullptr : list;
+            }
+        }
+
+        if (!fits)
+        {
+            LOG(LOG_SPAWNS, "(%d, %d) Entity %" PRId64 " does not fit in a list", offset().q(), offset().r(), entity->id());
+            continue;
+        }
+
+        if (written)
+        {
+            if (entry)
+            {
+                entry->bytes.assign(list->data() + begin, list->data() + list->written());
+            }
+
+            closeEntry();
+            continue;
+        }
+
+        // 0x0AAx are reserved packets
+        boost::intrusive_ptr<Packet> packet = spawn ? entity->spawnPacket() : entity->despawnPacket();
+        if (entry)
+        {
+            entry->listed = false;
+        }
+
+        if (!packet)
+        {
+            continue;
+        }
+
+        // Not opted in, its own frame goes along with the rest
+        packet->finalize();
+        if (entry)
+        {
+            entry->bytes.assign(packet->data(), packet->data() + packet->written());
+        }
+
+        appendFrame(packet->data(), packet->written());
     }
+
+    // Lists nobody wrote into
+    packets.erase(std::remove_if(packets.begin(), packets.end(), [](const boost::intrusive_ptr<Packet>& packet)
+        {
+            return !packet->framed() && packet->peek<uint16_t>(sizeof(uint16_t) * 2) == 0;
+        }
+    ), packets.end());  // NOLINT(whitespace/parens)
+
+    // Cached and shared with every requester from now on
+    for (auto& packet : packets)
+    {
+        packet->finalize();
+    }
+
+    return packets;
 }
 
 void Cell::request(MapAwareEntity* who, RequestType type)
@@ -218,11 +447,13 @@ void Cell::request(MapAwareEntity* who, RequestType type)
 
 void Cell::broadcast(boost::intrusive_ptr<Packet> packet)
 {
-    // There is nothing to broadcast if there is no plalyer at all
-    if (_clientsCount > 0)
+    // There is nothing to broadcast if nobody is looking
+    if (!_subscribers.empty())
     {
         LOG(LOG_SPAWNS, "(%d, %d) Broadcast requested", offset().q(), offset().r());
 
+        // Shared by all subscribers, possibly flushed from several threads
+        packet->finalize();
         _broadcast->push_back(packet);
     }
 }
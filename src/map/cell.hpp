@@ -9,6 +9,7 @@
 #include <list>
 #include <utility>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "defs/common.hpp"
@@ -20,6 +21,7 @@ INCL_WARN
 
 
 class Cell;
+class Client;
 class Cluster;
 struct ClusterCenter;
 class Map;
@@ -40,6 +42,14 @@ struct Request
     RequestType type;
 };
 
+// Spawn/despawn lists sent to each requester, one per cell and tick
+// count (u16), followed by count x (id (u64), length (u16), payload)
+constexpr uint16_t SpawnListOpcode = 0x0AA0;
+constexpr uint16_t DespawnListOpcode = 0x0AA1;
+
+// Lists are split once this big, or before an entry that does not fit
+constexpr uint16_t MaxEntityListBytes = 8 * 1024;
+
 class Cell
 {
     friend class Map;
@@ -55,6 +65,25 @@ class Cell
         uint64_t remaining;
     };
 
+    // What one entity wrote last time, either a list entry or its own frame
+    struct SpawnEntry
+    {
+        bool valid;
+        bool listed;
+        uint64_t tick;
+        std::vector<uint8_t> bytes;
+    };
+
+    // Spawns of all entities, serialized once for every requester
+    // Rebuilt lists copy the entries of entities that did not change
+    struct SpawnCache
+    {
+        bool valid;
+        uint64_t tick;
+        std::vector<boost::intrusive_ptr<Packet>> packets;
+        std::unordered_map<uint64_t /*id*/, SpawnEntry> entries;
+    };
+
 public:
     explicit Cell(Map* map, const Offset& offset);
     virtual ~Cell();
@@ -65,6 +94,9 @@ public:
     inline RadialQuadTree<MaxQuadrantEntities, MaxQuadtreeDepth>* quadtree() { return _quadTree; }
 
     virtual void update(uint64_t elapsed);
+    // Once every position is final (batched ones included), indexes entities
+    // and serves spawn/despawn requests
+    virtual void settle();
     virtual void physics(uint64_t elapsed);
     virtual void cleanup(uint64_t elapsed);
 
@@ -77,11 +109,31 @@ public:
     void broadcast(boost::intrusive_ptr<Packet> packet);
     void clearQueues();
 
+    // Clients seeing this cell, broadcasts are delivered to each of them
+    // NOT thread-safe, only changed from map operations
+    inline void subscribe(Client* client) { _subscribers.insert(client); }
+    inline void unsubscribe(Client* client) { _subscribers.erase(client); }
+    inline const std::unordered_set<Client*>& subscribers() { return _subscribers; }
+
+    // Packets broadcasted up to the last update, delivered by the map fan-out
+    inline const std::list<boost::intrusive_ptr<Packet>>& outgoing()
+    {
+        return _broadcast == &_broadcastQueue1 ? _broadcastQueue2 : _broadcastQueue1;
+    }
+
     std::vector<Cell*> inRadius(uint16_t radius = 1);
     std::vector<Cell*> ring(uint16_t radius = 1);
 
 private:
-    void processRequests(MapAwareEntity* entity);
+    void processRequests();
+
+    // Built on the first spawn request, kept until any entity changes
+    const SpawnCache& spawnCache();
+
+    // Spawn/despawn lists of all entities but `exclude`, followed by the
+    // packets of entities not writing into lists, back to back
+    // With `cache`, only entities changed since their last entry serialize
+    std::vector<boost::intrusive_ptr<Packet>> serialize(RequestType type, MapAwareEntity* exclude, SpawnCache* cache = nullptr);
 
 protected:
     const Offset _offset;
@@ -90,7 +142,7 @@ protected:
 
     RadialQuadTree<MaxQuadrantEntities, MaxQuadtreeDepth>* _quadTree;
     std::unordered_map<uint64_t /*id*/, MapAwareEntity*> _entities;
-    uint16_t _clientsCount;
+    std::unordered_set<Client*> _subscribers;
 
     // Use double lists to avoid locking and/or non-desired cleanups
     std::list<boost::intrusive_ptr<Packet>> _broadcastQueue1;
@@ -98,6 +150,7 @@ protected:
     std::list<boost::intrusive_ptr<Packet>>* _broadcast;
 
     std::list<Request> _requests;
+    SpawnCache _spawnCache;
 
 public:
     // TODO(gpascualg): Better encapsulation for stall information?
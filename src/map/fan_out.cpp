@@ -0,0 +1,79 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "map/fan_out.hpp"
+#include "map/cell.hpp"
+#include "map/map_aware_entity.hpp"
+#include "map/offset.hpp"
+#include "server/client.hpp"
+
+#include <algorithm>
+#include <future>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+FanOut::FanOut(threadpool11::Pool* pool) :
+    _pool(pool)
+{
+    _shards.resize(std::max<std::size_t>(_pool->getWorkerCount(), 1));
+}
+
+FanOut::~FanOut()
+{}
+
+void FanOut::collect(Cell* cell)
+{
+    if (cell->outgoing().empty())
+    {
+        return;
+    }
+
+    _frozen.push_back(cell->outgoing());
+    auto& packets = _frozen.back();
+
+    for (auto client : cell->subscribers())
+    {
+        Cell* seen = client->entity()->cell();
+        int distance = seen ? seen->offset().distance(cell->offset()) : 0;
+        _shards[client->id() % _shards.size()].push_back({ client, &packets, distance });  // NOLINT(whitespace/braces)
+    }
+}
+
+void FanOut::run()
+{
+    std::vector<std::future<void>> pending;
+    for (auto& shard : _shards)
+    {
+        if (shard.empty())
+        {
+            continue;
+        }
+
+        pending.push_back(_pool->postWork<void>([&shard]()
+            {
+                // Cells of the same distance keep the order they were collected in
+                std::stable_sort(shard.begin(), shard.end(), [](const Delivery& a, const Delivery& b)
+                    {
+                        return a.distance < b.distance;
+                    }
+                );  // NOLINT(whitespace/parens)
+
+                for (auto& delivery : shard)
+                {
+                    delivery.client->deliver(*delivery.packets);
+                }
+
+                shard.clear();
+            }
+        ));  // NOLINT(whitespace/parens)
+    }
+
+    // The pool might already be simulating the next tick (see Server::pipelined)
+    for (auto& work : pending)
+    {
+        work.wait();
+    }
+
+    _frozen.clear();
+}
@@ -0,0 +1,59 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <list>
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <threadpool11/threadpool11.hpp>
+#include "defs/intrusive.hpp"
+#include <boost/intrusive_ptr.hpp>
+INCL_WARN
+
+
+class Cell;
+class Client;
+class Packet;
+
+// Delivers what cells broadcast during a tick to the clients subscribed to them
+// Runs as its own stage, once simulation is over, thus simulation threads
+// never touch clients. Broadcasts are shared, immutable, packets, so only the
+// lists holding them are copied. Clients are split in shards, independently of how
+// cells are clustered, and each shard is sent from a worker of the cluster pool.
+// Each client gets the closest cells first, thus they come first out of its
+// delivery budget (see Client::deliver).
+class FanOut
+{
+private:
+    using Queue = std::list<boost::intrusive_ptr<Packet>>;
+
+    struct Delivery
+    {
+        Client* client;
+        const Queue* packets;
+        int distance;  // In cells, from the client entity
+    };
+
+public:
+    explicit FanOut(threadpool11::Pool* pool);
+    FanOut(const FanOut& fanOut) = delete;
+    virtual ~FanOut();
+
+    // NOT thread-safe, freezes a copy of the cell's queue along with its
+    // subscribers, the cell is free to clear or refill it afterwards
+    void collect(Cell* cell);
+
+    // Delivers everything collected so far and waits for it, not for
+    // anything else the pool might be running
+    // May run concurrently with the next simulation, but not with collect
+    void run();
+
+private:
+    threadpool11::Pool* _pool;
+    std::list<Queue> _frozen;
+    std::vector<std::vector<Delivery>> _shards;
+};
@@ -0,0 +1,166 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "map/interest.hpp"
+#include "debug/debug.hpp"
+#include "map/cell.hpp"
+#include "map/map-cluster/cluster.hpp"
+#include "map/map.hpp"
+#include "map/map_aware_entity.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+InterestManager::InterestManager(Map* map) :
+    _map(map)
+{
+    _disk.reserve(diskSize(MaxViewRadius));
+
+    const Offset origin(0, 0);
+    for (int32_t q = -MaxViewRadius; q <= MaxViewRadius; ++q)
+    {
+        for (int32_t r = -MaxViewRadius; r <= MaxViewRadius; ++r)
+        {
+            if (origin.distance({ q, r }) <= MaxViewRadius)  // NOLINT(whitespace/braces)
+            {
+                _disk.push_back({ q, r });  // NOLINT(whitespace/braces)
+            }
+        }
+    }
+
+    // Ring by ring, so that each disk is a prefix
+    std::stable_sort(_disk.begin(), _disk.end(), [&origin](const Direction& a, const Direction& b)
+        {
+            return origin.distance({ a.q, a.r }) < origin.distance({ b.q, b.r });  // NOLINT(whitespace/braces)
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+std::vector<Cell*> InterestManager::difference(Cell* center, uint8_t radius, Cell* exclude, uint8_t excludeRadius,
+    std::vector<Offset>* missing)
+{
+    LOG_ASSERT(radius <= MaxViewRadius, "View radius is too wide");
+
+    std::vector<Cell*> cells;
+    cells.reserve(diskSize(radius));
+
+    const Offset& offset = center->offset();
+    for (std::size_t i = 0; i < diskSize(radius); ++i)
+    {
+        Offset current(offset.q() + _disk[i].q, offset.r() + _disk[i].r);
+        if (exclude && exclude->offset().distance(current) <= excludeRadius)
+        {
+            continue;
+        }
+
+        // Siblings are always there, further cells only if something created them
+        Cell* cell = i < diskSize(DefaultViewRadius) ? _map->getOrCreate(current) : _map->get(current);
+        if (cell)
+        {
+            cells.push_back(cell);
+        }
+        else if (missing)
+        {
+            missing->push_back(current);
+        }
+    }
+
+    return cells;
+}
+
+std::vector<Cell*> InterestManager::enter(MapAwareEntity* entity, Cell* cell, Cell* old)
+{
+    std::vector<Offset> missing;
+    auto cells = difference(cell, entity->viewRadius(), old, entity->_interestRadius, &missing);
+    entity->_interestRadius = entity->viewRadius();
+
+    if (auto client = entity->client())
+    {
+        for (auto seen : cells)
+        {
+            LOG(LOG_CELL_CHANGES, "RequestType::SPAWN (%d, %d)", seen->offset().q(), seen->offset().r());
+            seen->subscribe(client);
+            seen->request(entity, RequestType::SPAWN);
+
+            // Requests are served by the cell update, far cells might be idle
+            if (!seen->stall.isOnCooldown)
+            {
+                _map->cluster()->touch(seen);
+            }
+        }
+
+        // Nothing to spawn yet, whatever gets there later is broadcasted
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        for (auto& offset : missing)
+        {
+            _pending[offset.hash()].insert(client);
+        }
+    }
+
+    return cells;
+}
+
+std::vector<Cell*> InterestManager::leave(MapAwareEntity* entity, Cell* cell, Cell* to)
+{
+    std::vector<Offset> missing;
+    auto cells = difference(cell, entity->_interestRadius, to, entity->viewRadius(), &missing);
+
+    if (auto client = entity->client())
+    {
+        for (auto seen : cells)
+        {
+            seen->unsubscribe(client);
+
+            // Do not request despawn paquets from old cells if we are disconnecting
+            if (to)
+            {
+                LOG(LOG_CELL_CHANGES, "RequestType::DESPAWN (%d, %d)", seen->offset().q(), seen->offset().r());
+                seen->request(entity, RequestType::DESPAWN);
+
+                if (!seen->stall.isOnCooldown)
+                {
+                    _map->cluster()->touch(seen);
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(_pendingMutex);
+        for (auto& offset : missing)
+        {
+            auto it = _pending.find(offset.hash());
+            if (it != _pending.end() && it->second.erase(client) && it->second.empty())
+            {
+                _pending.erase(it);
+            }
+        }
+    }
+
+    return cells;
+}
+
+void InterestManager::onCellCreated(Cell* cell)
+{
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    auto it = _pending.find(cell->offset().hash());
+    if (it == _pending.end())
+    {
+        return;
+    }
+
+    for (auto client : it->second)
+    {
+        cell->subscribe(client);
+    }
+
+    _pending.erase(it);
+}
+
+std::size_t InterestManager::pending(const Offset& offset)
+{
+    std::lock_guard<std::mutex> lock(_pendingMutex);
+    auto it = _pending.find(offset.hash());
+    return it != _pending.end() ? it->second.size() : 0;
+}
@@ -0,0 +1,80 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include "map/offset.hpp"
+
+#include <inttypes.h>
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+class Cell;
+class Client;
+class Map;
+class MapAwareEntity;
+
+// View radius, in cells, of entities not setting their own
+constexpr uint8_t DefaultViewRadius = 1;
+
+// Widest view radius, offset tables are precomputed up to it
+constexpr uint8_t MaxViewRadius = 16;
+
+// Which cells each entity sees, and who sees each cell
+// An entity sees every cell within its view radius, and its client is
+// subscribed to exactly those. Changing cells enters and leaves the exact set
+// differences of both disks, no matter how far apart they are.
+// Cells further than the siblings are not created just to be seen,
+// subscriptions to them are kept aside until the cell is created.
+class InterestManager
+{
+public:
+    explicit InterestManager(Map* map);
+    InterestManager(const InterestManager& interest) = delete;
+
+    // Number of cells within `radius` of any cell, itself included
+    static constexpr std::size_t diskSize(uint8_t radius)
+    {
+        return 1 + 3 * radius * (radius + 1);
+    }
+
+    // Relative offsets of the cells within MaxViewRadius, closest first
+    // The first diskSize(radius) of them make up any smaller disk
+    inline const std::vector<Direction>& disk() { return _disk; }
+
+    // NOT thread-safe
+    // Cells within `radius` of `center` but not within `excludeRadius` of
+    // `exclude`, or all of them if there is no `exclude`. Only the center and
+    // its siblings are created if missing, offsets of the missing cells further
+    // away go into `missing`, if given
+    std::vector<Cell*> difference(Cell* center, uint8_t radius, Cell* exclude, uint8_t excludeRadius,
+        std::vector<Offset>* missing = nullptr);
+
+    // NOT thread-safe, must be called from map operations
+    // Subscribes the entity's client to the cells it now sees and asks them
+    // for their spawns. Returns the cells entered
+    std::vector<Cell*> enter(MapAwareEntity* entity, Cell* cell, Cell* old);
+
+    // Same, unsubscribing from the cells not seen from `to` anymore and asking
+    // for their despawns, unless it is leaving the map
+    std::vector<Cell*> leave(MapAwareEntity* entity, Cell* cell, Cell* to);
+
+    // Subscribes whoever was waiting for the cell, called once it is created
+    void onCellCreated(Cell* cell);
+
+    // Clients waiting for the cell at `offset` to be created
+    std::size_t pending(const Offset& offset);
+
+private:
+    Map* _map;
+    std::vector<Direction> _disk;
+
+    // Cells may be created from map updates, thus this is locked
+    std::mutex _pendingMutex;
+    std::unordered_map<uint64_t /*hash*/, std::unordered_set<Client*>> _pending;
+};
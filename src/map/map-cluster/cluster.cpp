@@ -11,11 +11,13 @@
 #include "map/map.hpp"
 #include "map/map_aware_entity.hpp"
 #include "map/offset.hpp"
+#include "movement/motion_batch.hpp"
 #include "movement/motion_master.hpp"
 #include "physics/rect_bounding_box.hpp"
 #include "server/server.hpp"
 
 #include <algorithm>
+#include <future>
 #include <set>
 #include <vector>
 
@@ -47,29 +49,41 @@ void Cluster::update(uint64_t elapsed)
 
         for (uint16_t cid = 0; cid < _num_components; ++cid)
         {
-            _pool.postWork<void>([this, elapsed, cells = _cellsByCluster[cid]]()
+            _pending.push_back(_pool.postWork<void>([this, elapsed, cells = _cellsByCluster[cid]]()
             {
+                // Free motion of all entities is integrated in one pass
+                auto batch = MotionBatch::local();
+                batch->begin();
+
                 for (auto cell : cells)
                 {
                     cell->update(elapsed);
                 }
-            });  // NOLINT (whitespace/braces)
+
+                batch->end(elapsed);
+
+                // Batched positions have just been written back
+                for (auto cell : cells)
+                {
+                    cell->settle();
+                }
+            }));  // NOLINT (whitespace/braces)
         }
 
-        _pool.waitAll();
+        waitPending();
 
         for (uint16_t cid = 0; cid < _num_components; ++cid)
         {
-            _pool.postWork<void>([this, elapsed, cells = _cellsByCluster[cid]]()
+            _pending.push_back(_pool.postWork<void>([this, elapsed, cells = _cellsByCluster[cid]]()
             {
                 for (auto cell : cells)
                 {
                     cell->physics(elapsed);
                 }
-            });  // NOLINT (whitespace/braces)
+            }));  // NOLINT (whitespace/braces)
         }
 
-        _pool.waitAll();
+        waitPending();
     }
 
     Reactive::get()->onClusterUpdate(_num_components, _vertices.size() - _numStall, _numStall, _numStallCandidates);
@@ -81,7 +95,7 @@ void Cluster::cleanup(uint64_t elapsed)
     {
         for (uint16_t cid = 0; cid < _num_components; ++cid)
         {
-            _pool.postWork<void>([this, elapsed, cells = _cellsByCluster[cid]]()
+            _pending.push_back(_pool.postWork<void>([this, elapsed, cells = _cellsByCluster[cid]]()
             {
                 for (auto cell : cells)
                 {
@@ -101,10 +115,10 @@ void Cluster::cleanup(uint64_t elapsed)
                         }
                     }
                 }
-            });  // NOLINT (whitespace/braces)
+            }));  // NOLINT (whitespace/braces)
         }
 
-        _pool.waitAll();
+        waitPending();
 
         // Reinitialize
         _graph = {};
@@ -128,6 +142,17 @@ void Cluster::cleanup(uint64_t elapsed)
     _currentCells->clear();
 }
 
+void Cluster::waitPending()
+{
+    // Only our own work, the pool might be delivering the last tick (see FanOut)
+    for (auto& work : _pending)
+    {
+        work.wait();
+    }
+
+    _pending.clear();
+}
+
 uint16_t Cluster::processStallCells(uint64_t elapsed)
 {
     _numStallCandidates = _stallCells.size();
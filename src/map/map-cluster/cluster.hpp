@@ -16,6 +16,7 @@ INCL_WARN
 
 #include <array>
 #include <functional>
+#include <future>
 #include <list>
 #include <map>
 #include <unordered_set>
@@ -30,6 +31,7 @@ class MapAwareEntity;
 
 class Cluster
 {
+    friend class InterestManager;
     friend class Map;
 
 private:
@@ -56,10 +58,15 @@ public:
 
     inline std::size_t size() { return _num_components; }
 
+    // Workers updating cells, shared with later stages (see FanOut)
+    // Each stage waits on its own work only, thus they may overlap
+    inline threadpool11::Pool* pool() { return &_pool; }
+
 private:
     Cluster();
 
     uint16_t processStallCells(uint64_t elapsed);
+    void waitPending();
 
     bool touchWithNeighbours(Cell* cell, bool isStall = false);
     bool touch(Cell* cell, bool isStall = false);
@@ -67,6 +74,7 @@ private:
 
 private:
     threadpool11::Pool _pool;
+    std::vector<std::future<void>> _pending;
     boost::lockfree::queue<ClusterOperation, boost::lockfree::capacity<4096>> _scheduledOperations;
 
     using Graph = boost::adjacency_list<boost::vecS, boost::vecS, boost::undirectedS, Cell*>;
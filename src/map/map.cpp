@@ -3,10 +3,14 @@
 #include "map/map.hpp"
 #include "map/cell.hpp"
 #include "debug/debug.hpp"
+#include "map/fan_out.hpp"
+#include "map/interest.hpp"
 #include "map/map-cluster/cluster.hpp"
 #include "map/map_operation.hpp"
 #include "map/map_aware_entity.hpp"
 #include "movement/motion_master.hpp"
+#include "pathfinding/pathfinder.hpp"
+#include "server/client.hpp"
 
 #include <algorithm>
 #include <iterator>
@@ -23,10 +27,14 @@ INCL_NOWARN
 INCL_WARN
 
 
-Map::Map(boost::object_pool<Cell>* cellAllocator)
+Map::Map(boost::object_pool<Cell>* cellAllocator) :
+    _cellHysteresis(DefaultCellHysteresis)
 {
     _cellAllocator = cellAllocator ? cellAllocator : new boost::object_pool<Cell>(2048);
     _cluster = new Cluster();
+    _fanOut = new FanOut(_cluster->pool());
+    _interest = new InterestManager(this);
+    _pathfinder = new Pathfinder(DefaultPathfinderThreads);
     _scheduledOperations = new boost::lockfree::queue<MapOperation*>(2048);
 }
 
@@ -34,15 +42,32 @@ Map::~Map()
 {
     delete _cellAllocator;
     delete _cluster;
+    delete _fanOut;
+    delete _interest;
+    delete _pathfinder;
     delete _scheduledOperations;
 }
 
 void Map::update(uint64_t elapsed)
 {
     runScheduledOperations();
+    pathfinder()->tick();
     cluster()->update(elapsed);
 }
 
+void Map::collect()
+{
+    for (auto const& pair : cluster()->_vertices)
+    {
+        _fanOut->collect(pair.first);
+    }
+}
+
+void Map::fanOut()
+{
+    _fanOut->run();
+}
+
 void Map::cleanup(uint64_t elapsed)
 {
     cluster()->cleanup(elapsed);
@@ -92,6 +117,15 @@ void Map::runScheduledOperations()
                 break;
 
             case MapOperationType::DESTROY:
+                // Someone is still looking at it, back to a regular cell
+                if (!operation->param->subscribers().empty())
+                {
+                    operation->param->stall.isRegistered = false;
+                    operation->param->stall.isOnCooldown = false;
+                    cluster()->touch(operation->param);
+                    break;
+                }
+
                 _cells.erase(std::make_pair(operation->offset.q(), operation->offset.r()));
                 _cellAllocator->destroy(operation->param);
                 // TODO: When a cell is destroyed, entities inside should be also deleted
@@ -108,59 +142,66 @@ void Map::runScheduledOperations()
 
 void Map::broadcastToSiblings(Cell* cell, boost::intrusive_ptr<Packet> packet)
 {
+    // Clients around subscribed to it already
     cell->broadcast(packet);
-
-    auto cells = getSiblings(cell);
-    broadcast(cells, packet);
 }
 
 void Map::broadcastExcluding(Cell* cell, Cell* exclude, boost::intrusive_ptr<Packet> packet)
 {
-    auto cells = getCellsExcluding(cell, exclude);
-    broadcast(cells, packet);
+    if (!packet)
+    {
+        return;
+    }
+
+    for (auto client : cell->subscribers())
+    {
+        if (!exclude || exclude->subscribers().find(client) == exclude->subscribers().end())
+        {
+            client->send(packet);
+        }
+    }
 }
 
 std::vector<Cell*> Map::getCellsExcluding(Cell* cell, Cell* exclude)
 {
-    if (!exclude || !cell)
+    if (!cell)
     {
-        auto ref = cell ? cell : exclude;
-        auto cells = createSiblings(ref);
-        cells.push_back(ref);
-        return cells;
+        return interest()->difference(exclude, DefaultViewRadius, nullptr, 0);
     }
 
-    auto offsetCell = cell->offset();
-    auto offsetExclude = exclude->offset();
-    auto directionQ = offsetCell.q() - offsetExclude.q();
-    auto directionR = offsetCell.r() - offsetExclude.r();
-
-    auto idx = directionIdxs(directionQ, directionR);
-    auto i = idx == 0 ? MAX_DIR_IDX - 1 : idx - 1;
-    auto j = (idx + 1) % MAX_DIR_IDX;
-
-    auto cell1 = getOrCreate({ offsetCell.q() + directionQ,  // NOLINT(whitespace/braces)
-        offsetCell.r() + directionR });  // NOLINT(whitespace/braces)
-
-    auto cell2 = getOrCreate({ offsetCell.q() + directions[i].q,  // NOLINT(whitespace/braces)
-        offsetCell.r() + directions[i].r });  // NOLINT(whitespace/braces)
-
-    auto cell3 = getOrCreate({ offsetCell.q() + directions[j].q,  // NOLINT(whitespace/braces)
-        offsetCell.r() + directions[j].r });  // NOLINT(whitespace/braces)
-
-    return { cell1, cell2, cell3 };
+    return interest()->difference(cell, DefaultViewRadius, exclude, DefaultViewRadius);
 }
 
 void Map::onMove(MapAwareEntity* entity)
 {
-    auto& pos = entity->motionMaster()->position();
-    auto offset = offsetOf(pos.x, pos.z);
+    auto motionMaster = entity->motionMaster();
+    auto current = entity->cell();
+    if (!current)
+    {
+        return;
+    }
+
+    // Do not leave the cell until past its edge by the hysteresis margin,
+    // otherwise entities on a border keep bouncing between both cells
+    auto pos = motionMaster->position2D();
+    auto center = current->offset().center();
+    float slack = distanceToCellEdge(pos.x - center.x, pos.y - center.y) + _cellHysteresis;
+    if (slack >= 0)
+    {
+        motionMaster->cellSlack(slack);
+        return;
+    }
+
+    auto offset = offsetOf(pos.x, pos.y);
     Cell* cell = getOrCreate(offset);
 
-    if (cell != entity->cell())
+    center = offset.center();
+    motionMaster->cellSlack(distanceToCellEdge(pos.x - center.x, pos.y - center.y) + _cellHysteresis);
+
+    if (cell != current)
     {
-        removeFrom(entity->cell(), entity, cell);
-        addTo(cell, entity, entity->cell());
+        removeFrom(current, entity, cell);
+        addTo(cell, entity, current);
     }
 }
 
@@ -278,6 +319,7 @@ Cell* Map::getOrCreate(const Offset& offset)
 
         // TODO(gpascualg): Is it safe doing Cluster::onCellCreated here?
         cluster()->onCellCreated(cell);
+        interest()->onCellCreated(cell);
     }
 
     return cell;
@@ -25,8 +25,11 @@ INCL_WARN
 class Cell;
 class CellAllocator;
 class Cluster;
+class FanOut;
+class InterestManager;
 class Map;
 class MapAwareEntity;
+class Pathfinder;
 struct MapOperation;
 
 namespace std
@@ -45,6 +48,12 @@ template<typename S, typename T> struct hash<pair<S, T>>
 
 static inline void dummy(Cell* cell) {}
 
+// Distance an entity must go past its cell edge before changing cell
+constexpr float DefaultCellHysteresis = 5.0f;
+
+// Dedicated threads solving path requests
+constexpr uint8_t DefaultPathfinderThreads = 1;
+
 class Map
 {
 public:
@@ -54,6 +63,13 @@ public:
 
     void update(uint64_t elapsed);
     void cleanup(uint64_t elapsed);
+
+    // Freezes this tick broadcasts of the updated cells, along with their
+    // clients. Must run after update and before cleanup, which clears them
+    void collect();
+
+    // Delivers what was last collected, may overlap the next update
+    void fanOut();
     void runScheduledOperations();
 
     // Broadcast operations
@@ -73,11 +89,18 @@ public:
         broadcast(cells, packet, dummy);
     }
 
+    // Queues the packet for every client seeing `cell`, which are those
+    // subscribed to it (ie. the ones in it and its siblings)
     void broadcastToSiblings(Cell* cell, boost::intrusive_ptr<Packet> packet);
+
+    // NOT thread-safe, sends right away to the clients seeing `cell` but not
+    // `exclude`, or to all of them if there is no `exclude`
     void broadcastExcluding(Cell* cell, Cell* exclude, boost::intrusive_ptr<Packet> packet);
 
     // Automated add/remove
     void onMove(MapAwareEntity* entity);
+    inline float cellHysteresis() { return _cellHysteresis; }
+    inline void cellHysteresis(float margin) { _cellHysteresis = margin; }
 
     // Schedules an ADD (and maybe CREATE) operations
     void addTo(MapAwareEntity* e, Cell* old);
@@ -107,6 +130,7 @@ public:
     Cell* getOrCreate(const Offset& offset);
 
     // NOT thread-safe
+    // Cells seen from `cell` but not from `exclude`, at the default view radius
     std::vector<Cell*> getCellsExcluding(Cell* cell, Cell* exclude);
 
     // NOT thread-safe
@@ -115,13 +139,20 @@ public:
     std::vector<Cell*> getSiblings(Cell* cell);
 
     inline Cluster* cluster() { return _cluster; }
+    inline InterestManager* interest() { return _interest; }
+    inline Pathfinder* pathfinder() { return _pathfinder; }
     inline uint32_t size() { return _cells.size(); }
 
 
 private:
     boost::object_pool<Cell>* _cellAllocator;
     Cluster* _cluster;
+    FanOut* _fanOut;
+    InterestManager* _interest;
+    Pathfinder* _pathfinder;
 
     std::unordered_map<std::pair<int32_t, int32_t> /*hash*/, Cell*> _cells;
     boost::lockfree::queue<MapOperation*>* _scheduledOperations;
+
+    float _cellHysteresis;
 };
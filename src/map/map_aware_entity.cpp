@@ -1,13 +1,17 @@
 /* Copyright 2016 Guillem Pascual */
 
 #include "map/cell.hpp"
+#include "io/bit_stream.hpp"
+#include "io/packet.hpp"
 #include "server/client.hpp"
+#include "map/interest.hpp"
 #include "map/map.hpp"
 #include "map/map_aware_entity.hpp"
 #include "movement/motion_master.hpp"
 #include "physics/rect_bounding_box.hpp"
 #include "server/server.hpp"
 
+#include <math.h>
 #include <list>
 #include <utility>
 #include <vector>
@@ -22,6 +26,9 @@ MapAwareEntity::MapAwareEntity(uint64_t id, Client* client) :
 {
     _motionMaster = new MotionMaster(this);
     _isUpdater = client != nullptr;
+    _changedAt.fill(0);
+    _viewRadius = DefaultViewRadius;
+    _interestRadius = DefaultViewRadius;
 }
 
 MapAwareEntity::~MapAwareEntity()
@@ -33,10 +40,58 @@ void MapAwareEntity::update(uint64_t elapsed)
 {
     Executor<ExecutorQueueMax>::executeJobs();
 
+    // Inputs meant for this tick
+    if (_client)
+    {
+        _client->inputs()->apply(this, Server::get()->tick());
+    }
+
     // Update motion
     _motionMaster->update(elapsed);
 }
 
+void MapAwareEntity::dirty(uint8_t field)
+{
+    LOG_ASSERT(field < MaxEntityFields, "Too many replicated fields");
+    _changedAt[field] = Server::get()->tick();
+}
+
+uint16_t MapAwareEntity::changedSince(uint64_t tick)
+{
+    uint16_t mask = 0;
+    for (uint8_t field = 0; field < fieldCount(); ++field)
+    {
+        if (_changedAt[field] > tick)
+        {
+            mask |= 1 << field;
+        }
+    }
+
+    return mask;
+}
+
+void MapAwareEntity::writeField(uint8_t field, BitWriter& writer)
+{
+    switch (field)
+    {
+        case PositionField:
+            writer.writeCellPosition(_motionMaster->position2D());
+            writer.write(f2u{ _motionMaster->position().y }.u, 32);  // NOLINT(whitespace/braces)
+            break;
+
+        case ForwardField:
+        {
+            auto forward = _motionMaster->forward();
+            writer.writeAngle(std::atan2(forward.x, forward.z));
+            break;
+        }
+
+        case SpeedField:
+            writer.write(f2u{ _motionMaster->speed() }.u, 32);  // NOLINT(whitespace/braces)
+            break;
+    }
+}
+
 void MapAwareEntity::setupBoundingBox(std::initializer_list<glm::vec2>&& vertices)
 {
     // TODO(gpascualg): Logging friendly assert
@@ -52,17 +107,11 @@ std::vector<Cell*> MapAwareEntity::onAdded(Cell* cell, Cell* old)
 
     LOG(LOG_CELL_CHANGES, "MapAwareEntity::onAdded (%" PRId64 ")", id());
 
-    // Broadcast all packets
-    auto newCells = cell->map()->getCellsExcluding(cell, old);
-    Server::get()->map()->broadcast(newCells, packet, [this](Cell* cell)
-        {
-            LOG(LOG_CELL_CHANGES, "RequestType::SPAWN (%d, %d)", cell->offset().q(), cell->offset().r());
-            if (client())
-            {
-                cell->request(this, RequestType::SPAWN);
-            }
-        }
-    );  // NOLINT(whitespace/parens)
+    // Start looking at the new cells, and ask for what is in them
+    auto newCells = cell->map()->interest()->enter(this, cell, old);
+
+    // Whoever could not see us before does now
+    cell->map()->broadcastExcluding(cell, old, packet);
 
     return newCells;
 }
@@ -75,24 +124,11 @@ std::vector<Cell*> MapAwareEntity::onRemoved(Cell* cell, Cell* to)
 
     LOG(LOG_CELL_CHANGES, "MapAwareEntity::onRemoved (%" PRId64 ")", id());
 
-    // Broadcast all packets
-    auto oldCells = cell->map()->getCellsExcluding(cell, to);
+    // Stop looking at the old cells
+    auto oldCells = cell->map()->interest()->leave(this, cell, to);
 
-    // Do not request despawn paquets from old cells if we are disconnecting
-    // or we are not a client
-    if (to && client())
-    {
-        Server::get()->map()->broadcast(oldCells, packet, [this](Cell* cell)
-            {
-                LOG(LOG_CELL_CHANGES, "RequestType::DESPAWN (%d, %d)", cell->offset().q(), cell->offset().r());
-                cell->request(this, RequestType::DESPAWN);
-            }
-        );  // NOLINT(whitespace/parens)
-    }
-    else
-    {
-        Server::get()->map()->broadcast(oldCells, packet);
-    }
+    // Whoever can not see us anymore
+    cell->map()->broadcastExcluding(cell, to, packet);
 
     return oldCells;
 }
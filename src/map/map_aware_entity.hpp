@@ -2,7 +2,11 @@
 
 #pragma once
 
+#include "map/interest.hpp"
+
 #include <inttypes.h>
+#include <algorithm>
+#include <array>
 #include <list>
 #include <queue>
 #include <vector>
@@ -17,19 +21,34 @@ INCL_NOWARN
 INCL_WARN
 
 
+class BitWriter;
 class BoundingBox;
 class Cell;
 class Client;
+struct Input;
 class MapAwareEntity;
 class MotionMaster;
 class Packet;
 
 
+// Replicated fields, derived entities add theirs starting at UserField
+enum EntityField : uint8_t
+{
+    PositionField   = 0,
+    ForwardField    = 1,
+    SpeedField      = 2,
+    UserField       = 3
+};
+
+// Fields are tracked in a 16 bits mask
+constexpr uint8_t MaxEntityFields = 16;
+
 // Using 16-queued jobs per-cicle&client should be more than enough
 constexpr const uint16_t ExecutorQueueMax = 16;
 class MapAwareEntity : public Executor<ExecutorQueueMax>
 {
     friend class Map;
+    friend class InterestManager;
 
 public:
     explicit MapAwareEntity(uint64_t id, Client* client = nullptr);
@@ -47,11 +66,36 @@ public:
     virtual std::vector<Cell*> onAdded(Cell* cell, Cell* old);
     virtual std::vector<Cell*> onRemoved(Cell* cell, Cell* to);
 
+    // Client inputs, on the tick they were meant for (see InputQueue)
+    virtual void onInput(const Input& input) {}
+
     virtual Packet* spawnPacket() = 0;
     virtual Packet* despawnPacket() = 0;
 
+    // Opt-in alternative to the above, appends the payload to a shared
+    // spawn/despawn list instead (see SpawnListOpcode)
+    // Must return false, without writing anything, if not supported
+    virtual bool writeSpawn(Packet* packet) { return false; }
+    virtual bool writeDespawn(Packet* packet) { return false; }
+
+    // Field-level dirty tracking, by the tick in which they last changed
+    void dirty(uint8_t field);
+    uint16_t changedSince(uint64_t tick);
+
+    // Replication of each field, see Replication
+    virtual uint8_t fieldCount() { return UserField; }
+    virtual void writeField(uint8_t field, BitWriter& writer);
+
     inline bool isUpdater() { return _isUpdater; }
 
+    // Cells seen around its own, wider ones are clamped to MaxViewRadius
+    // Applied the next time it changes cell
+    inline uint8_t viewRadius() { return _viewRadius; }
+    inline void viewRadius(uint8_t radius) { _viewRadius = std::min(radius, MaxViewRadius); }
+
+    // The one applied, which its client is subscribed with
+    inline uint8_t interestRadius() { return _interestRadius; }
+
 protected:
     inline void cell(Cell* cell) { _cell = cell; }
 
@@ -64,6 +108,12 @@ protected:
     MotionMaster* _motionMaster;
 
     bool _isUpdater;
+
+private:
+    std::array<uint64_t, MaxEntityFields> _changedAt;
+
+    uint8_t _viewRadius;
+    uint8_t _interestRadius;  // The one its client is subscribed with
 };
 
 
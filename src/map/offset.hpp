@@ -111,6 +111,19 @@ cond_constexpr inline Offset offsetOf(float x, float y)
     return Offset{ q_int, r_int };
 }
 
+// Cells are flat-topped hexagons, the apothem is the center-to-edge distance
+constexpr float cellApothem = cellSize_x * 0.866025403784f;  // sqrt(3) / 2
+
+// Signed distance from a point, relative to a cell center, to the cell edges
+// It is positive while inside the cell, and does not require any sqrt
+inline float distanceToCellEdge(float dx, float dy)
+{
+    float a = std::abs(dy);
+    float b = std::abs(0.866025403784f * dx + 0.5f * dy);
+    float c = std::abs(0.866025403784f * dx - 0.5f * dy);
+    return cellApothem - std::max(a, std::max(b, c));
+}
+
 // Directions
 struct Direction
 {
@@ -0,0 +1,99 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "movement/arc_length.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+
+// Number of linear segments used to measure the curve when building a table
+constexpr const int MeasureSegments = ArcLengthTable::Samples * 8;
+
+static inline glm::vec2 cubic(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d, float t)
+{
+    float u = 1.0f - t;
+    return u * u * u * a + 3 * u * u * t * b + 3 * u * t * t * c + t * t * t * d;
+}
+
+thread_local std::unordered_map<ArcLengthCache::Key, std::shared_ptr<const ArcLengthTable>, ArcLengthCache::KeyHash> ArcLengthCache::_tables;
+
+
+ArcLengthTable::ArcLengthTable(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d) :
+    _length(0)
+{
+    // Measure the curve with fine linear segments
+    float lengths[MeasureSegments + 1];
+    lengths[0] = 0;
+
+    glm::vec2 origin = a;
+    for (int i = 1; i <= MeasureSegments; ++i)
+    {
+        glm::vec2 p = cubic(a, b, c, d, i / static_cast<float>(MeasureSegments));
+        lengths[i] = lengths[i - 1] + glm::distance(p, origin);
+        origin = p;
+    }
+
+    _length = lengths[MeasureSegments];
+
+    // Invert it, find the curve parameter at evenly spaced distances
+    _t[0] = 0;
+    _t[Samples] = 1;
+
+    int j = 0;
+    for (int k = 1; k < Samples; ++k)
+    {
+        float target = _length * k / static_cast<float>(Samples);
+        while (j < MeasureSegments - 1 && lengths[j + 1] < target)
+        {
+            ++j;
+        }
+
+        float segment = lengths[j + 1] - lengths[j];
+        float fraction = segment > 0 ? (target - lengths[j]) / segment : 0;
+        _t[k] = (j + fraction) / static_cast<float>(MeasureSegments);
+    }
+}
+
+std::size_t ArcLengthCache::KeyHash::operator()(const Key& key) const
+{
+    std::hash<float> hasher;
+    std::size_t seed = 0;
+    for (float v : { key.b.x, key.b.y, key.c.x, key.c.y, key.d.x, key.d.y })  // NOLINT(whitespace/braces)
+    {
+        seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+}
+
+std::shared_ptr<const ArcLengthTable> ArcLengthCache::get(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d)
+{
+    Key key{ b - a, c - a, d - a };  // NOLINT(whitespace/braces)
+
+    auto it = _tables.find(key);
+    if (it != _tables.end())
+    {
+        return it->second;
+    }
+
+    // Curves already using a table keep it alive
+    if (_tables.size() >= MaxArcLengthTables)
+    {
+        _tables.clear();
+    }
+
+    auto table = std::make_shared<const ArcLengthTable>(a, b, c, d);
+    _tables.emplace(key, table);
+    return table;
+}
+
+void ArcLengthCache::clear()
+{
+    _tables.clear();
+}
+
+std::size_t ArcLengthCache::size()
+{
+    return _tables.size();
+}
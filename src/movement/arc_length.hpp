@@ -0,0 +1,81 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+// Arc-length parametrization of a cubic bezier
+// The curve parameter is sampled at evenly spaced distances, so that mapping
+// a travelled distance back to the curve is a single lerp: no sqrt and no
+// search while moving, and the resulting speed is constant along the curve
+class ArcLengthTable
+{
+public:
+    static constexpr int Samples = 16;
+
+    ArcLengthTable(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d);
+
+    inline float length() const { return _length; }
+
+    // Curve parameter at a given fraction [0, 1] of the total length
+    inline float parameter(float fraction) const
+    {
+        float x = std::min(std::max(fraction, 0.0f), 1.0f) * Samples;
+        int i = std::min(static_cast<int>(x), Samples - 1);
+        return _t[i] + (_t[i + 1] - _t[i]) * (x - i);
+    }
+
+private:
+    float _length;
+    float _t[Samples + 1];
+};
+
+
+// Tables kept per thread, at most, before starting over
+constexpr std::size_t MaxArcLengthTables = 1024;
+
+// Shares tables between curves with the same shape
+// Arc-length does not change with translation, thus curves are keyed by their
+// control points relative to the start one (ie. template patrol routes)
+// Each thread keeps its own tables, no locking is involved
+class ArcLengthCache
+{
+private:
+    struct Key
+    {
+        glm::vec2 b;
+        glm::vec2 c;
+        glm::vec2 d;
+
+        inline bool operator==(const Key& other) const
+        {
+            return b == other.b && c == other.c && d == other.d;
+        }
+    };
+
+    struct KeyHash
+    {
+        std::size_t operator()(const Key& key) const;
+    };
+
+public:
+    static std::shared_ptr<const ArcLengthTable> get(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d);
+
+    // Of the calling thread only
+    static void clear();
+    static std::size_t size();
+
+private:
+    static thread_local std::unordered_map<Key, std::shared_ptr<const ArcLengthTable>, KeyHash> _tables;
+};
@@ -0,0 +1,231 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "movement/motion_batch.hpp"
+#include "movement/motion_master.hpp"
+#include "map/cell.hpp"
+#include "map/map.hpp"
+#include "map/map_aware_entity.hpp"
+#include "map/offset.hpp"
+#include "physics/bounding_box.hpp"
+#include "server/server.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "defs/common.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MOTION_BATCH_SSE
+    #include <emmintrin.h>
+#endif
+
+
+thread_local MotionBatch* MotionBatch::_current = nullptr;
+
+MotionBatch* MotionBatch::local()
+{
+    static thread_local MotionBatch batch;
+    return &batch;
+}
+
+void MotionBatch::begin()
+{
+    _motionMasters.clear();
+    _crossed.clear();
+
+    _positionX.clear();
+    _positionY.clear();
+    _positionZ.clear();
+    _forwardX.clear();
+    _forwardY.clear();
+    _forwardZ.clear();
+    _speed.clear();
+    _angularSpeed.clear();
+    _centerX.clear();
+    _centerZ.clear();
+
+    _current = this;
+}
+
+void MotionBatch::push(MotionMaster* motionMaster)
+{
+    const auto& position = motionMaster->_position;
+    const auto& forward = motionMaster->_forward;
+
+    _motionMasters.push_back(motionMaster);
+    _positionX.push_back(position.x);
+    _positionY.push_back(position.y);
+    _positionZ.push_back(position.z);
+    _forwardX.push_back(forward.x);
+    _forwardY.push_back(forward.y);
+    _forwardZ.push_back(forward.z);
+    _speed.push_back(motionMaster->isMoving() ? motionMaster->_speed : 0.0f);
+    _angularSpeed.push_back(motionMaster->isRotating() ? motionMaster->_rotationAngle : 0.0f);
+
+    // Entities without a cell are never reported as crossing
+    if (auto cell = motionMaster->_owner->cell())
+    {
+        auto center = cell->offset().center();
+        _centerX.push_back(center.x);
+        _centerZ.push_back(center.y);
+    }
+    else
+    {
+        _centerX.push_back(position.x);
+        _centerZ.push_back(position.z);
+    }
+}
+
+void MotionBatch::end(uint64_t elapsed)
+{
+    _current = nullptr;
+
+    if (!_motionMasters.empty())
+    {
+        integrate(static_cast<float>(elapsed));
+        commit(static_cast<float>(elapsed));
+    }
+}
+
+void MotionBatch::integrate(float elapsed)
+{
+    std::size_t count = _motionMasters.size();
+    _cos.resize(count);
+    _sin.resize(count);
+    _edge.resize(count);
+
+    // Trigonometry is the only non-vectorizable part
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        float angle = _angularSpeed[i] * elapsed;
+        _cos[i] = angle != 0 ? std::cos(angle) : 1.0f;
+        _sin[i] = angle != 0 ? std::sin(angle) : 0.0f;
+    }
+
+    std::size_t i = 0;
+
+#if defined(MOTION_BATCH_SSE)
+    const __m128 time = _mm_set1_ps(elapsed);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 cos30 = _mm_set1_ps(0.866025403784f);
+    const __m128 apothem = _mm_set1_ps(cellApothem);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 fx = _mm_loadu_ps(&_forwardX[i]);
+        __m128 fy = _mm_loadu_ps(&_forwardY[i]);
+        __m128 fz = _mm_loadu_ps(&_forwardZ[i]);
+        __m128 c = _mm_loadu_ps(&_cos[i]);
+        __m128 s = _mm_loadu_ps(&_sin[i]);
+
+        // Rotate around Y, same as glm::rotateY
+        __m128 rx = _mm_add_ps(_mm_mul_ps(fx, c), _mm_mul_ps(fz, s));
+        __m128 rz = _mm_sub_ps(_mm_mul_ps(fz, c), _mm_mul_ps(fx, s));
+
+        // Only rotating entities get their forward normalized
+        __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(fy, fy)), _mm_mul_ps(rz, rz)));
+        __m128 rotating = _mm_cmpneq_ps(_mm_loadu_ps(&_angularSpeed[i]), zero);
+        __m128 scale = _mm_or_ps(_mm_and_ps(rotating, _mm_div_ps(one, len)), _mm_andnot_ps(rotating, one));
+        fx = _mm_mul_ps(rx, scale);
+        fy = _mm_mul_ps(fy, scale);
+        fz = _mm_mul_ps(rz, scale);
+
+        _mm_storeu_ps(&_forwardX[i], fx);
+        _mm_storeu_ps(&_forwardY[i], fy);
+        _mm_storeu_ps(&_forwardZ[i], fz);
+
+        // Advance
+        __m128 distance = _mm_mul_ps(_mm_loadu_ps(&_speed[i]), time);
+        __m128 px = _mm_add_ps(_mm_loadu_ps(&_positionX[i]), _mm_mul_ps(fx, distance));
+        __m128 py = _mm_add_ps(_mm_loadu_ps(&_positionY[i]), _mm_mul_ps(fy, distance));
+        __m128 pz = _mm_add_ps(_mm_loadu_ps(&_positionZ[i]), _mm_mul_ps(fz, distance));
+
+        _mm_storeu_ps(&_positionX[i], px);
+        _mm_storeu_ps(&_positionY[i], py);
+        _mm_storeu_ps(&_positionZ[i], pz);
+
+        // Distance to the current cell edges, see distanceToCellEdge
+        __m128 dx = _mm_mul_ps(_mm_sub_ps(px, _mm_loadu_ps(&_centerX[i])), cos30);
+        __m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&_centerZ[i]));
+        __m128 a = _mm_andnot_ps(sign, dz);
+        __m128 b = _mm_andnot_ps(sign, _mm_add_ps(dx, _mm_mul_ps(dz, half)));
+        __m128 d = _mm_andnot_ps(sign, _mm_sub_ps(dx, _mm_mul_ps(dz, half)));
+        _mm_storeu_ps(&_edge[i], _mm_sub_ps(apothem, _mm_max_ps(a, _mm_max_ps(b, d))));
+    }
+#endif
+
+    integrate(i, count, elapsed);
+}
+
+void MotionBatch::integrate(std::size_t from, std::size_t to, float elapsed)
+{
+    for (std::size_t i = from; i < to; ++i)
+    {
+        float fx = _forwardX[i] * _cos[i] + _forwardZ[i] * _sin[i];
+        float fy = _forwardY[i];
+        float fz = _forwardZ[i] * _cos[i] - _forwardX[i] * _sin[i];
+
+        if (_angularSpeed[i] != 0)
+        {
+            float scale = 1.0f / std::sqrt(fx * fx + fy * fy + fz * fz);
+            fx *= scale;
+            fy *= scale;
+            fz *= scale;
+        }
+
+        _forwardX[i] = fx;
+        _forwardY[i] = fy;
+        _forwardZ[i] = fz;
+
+        float distance = _speed[i] * elapsed;
+        _positionX[i] += fx * distance;
+        _positionY[i] += fy * distance;
+        _positionZ[i] += fz * distance;
+
+        _edge[i] = distanceToCellEdge(_positionX[i] - _centerX[i], _positionZ[i] - _centerZ[i]);
+    }
+}
+
+void MotionBatch::commit(float elapsed)
+{
+    float hysteresis = Server::get()->map()->cellHysteresis();
+
+    std::size_t count = _motionMasters.size();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto motionMaster = _motionMasters[i];
+        motionMaster->_position = { _positionX[i], _positionY[i], _positionZ[i] };  // NOLINT(whitespace/braces)
+        motionMaster->_forward = { _forwardX[i], _forwardY[i], _forwardZ[i] };  // NOLINT(whitespace/braces)
+
+        if (_speed[i] != 0)
+        {
+            motionMaster->_owner->dirty(PositionField);
+        }
+
+        if (_angularSpeed[i] != 0)
+        {
+            motionMaster->_owner->dirty(ForwardField);
+
+            if (auto bb = motionMaster->_owner->boundingBox())
+            {
+                bb->rotate(_angularSpeed[i] * elapsed);
+            }
+        }
+
+        // Same hysteresis as Map::onMove, so that it never bounces back
+        motionMaster->_cellSlack = _edge[i] + hysteresis;
+        if (motionMaster->_cellSlack < 0)
+        {
+            _crossed.push_back(motionMaster);
+        }
+    }
+
+    // Only those that left their cell need to go through the map
+    for (auto motionMaster : _crossed)
+    {
+        Server::get()->map()->onMove(motionMaster->_owner);
+    }
+}
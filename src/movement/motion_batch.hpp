@@ -0,0 +1,58 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+class MotionMaster;
+
+// Integrates free (generator-less) motion of many entities at once
+// State is gathered into contiguous arrays while entities are updated,
+// integrated in a single (SIMD) pass and then scattered back. Only those
+// entities which might have changed cell are reported to the map.
+class MotionBatch
+{
+public:
+    // Batch of the calling thread, only if it is currently collecting
+    static inline MotionBatch* current() { return _current; }
+
+    // Thread-owned batch, reused to avoid reallocations each tick
+    static MotionBatch* local();
+
+    void begin();
+    void push(MotionMaster* motionMaster);
+    void end(uint64_t elapsed);
+
+    inline std::size_t size() { return _motionMasters.size(); }
+    inline const std::vector<MotionMaster*>& crossed() { return _crossed; }
+
+private:
+    void integrate(float elapsed);
+    void integrate(std::size_t from, std::size_t to, float elapsed);
+    void commit(float elapsed);
+
+private:
+    static thread_local MotionBatch* _current;
+
+    std::vector<MotionMaster*> _motionMasters;
+    std::vector<MotionMaster*> _crossed;
+
+    // Structure of arrays, one entry per pushed motion master
+    std::vector<float> _positionX;
+    std::vector<float> _positionY;
+    std::vector<float> _positionZ;
+    std::vector<float> _forwardX;
+    std::vector<float> _forwardY;
+    std::vector<float> _forwardZ;
+    std::vector<float> _speed;
+    std::vector<float> _angularSpeed;
+    std::vector<float> _cos;
+    std::vector<float> _sin;
+    std::vector<float> _centerX;
+    std::vector<float> _centerZ;
+    std::vector<float> _edge;
+};
@@ -1,6 +1,7 @@
 /* Copyright 2016 Guillem Pascual */
 
 #include "movement/motion_master.hpp"
+#include "movement/motion_batch.hpp"
 #include "map/map_aware_entity.hpp"
 #include "map/map.hpp"
 #include "movement/movement_generator.hpp"
@@ -8,6 +9,7 @@
 #include "debug/debug.hpp"
 #include "physics/bounding_box.hpp"
 
+#include <cmath>
 #include <utility>
 
 #include "defs/common.hpp"
@@ -24,7 +26,9 @@ MotionMaster::MotionMaster(MapAwareEntity* owner) :
     _flags(0),
     _position{0, 0, 0},
     _forward{0, 0, 1},
-    _speed(0)
+    _rotationAngle(0),
+    _speed(0),
+    _cellSlack(0)
 {}
 
 void MotionMaster::update(uint64_t elapsed)
@@ -39,10 +43,18 @@ void MotionMaster::update(uint64_t elapsed)
         }
         else
         {
-            _position = newPos;
+            std::swap(_position, newPos);
+            travelled(newPos);
+        }
+    }
 
-            // TODO(gpascualg): This can be throttled, no need to do cell-changer per tick
-            Server::get()->map()->onMove(_owner);
+    // Free motion is integrated in bulk, if the cluster is collecting it
+    if (!_generator && (isMoving() || isRotating()))
+    {
+        if (auto batch = MotionBatch::current())
+        {
+            batch->push(this);
+            return;
         }
     }
 
@@ -51,6 +63,7 @@ void MotionMaster::update(uint64_t elapsed)
         float elapsedAngle = _rotationAngle * elapsed;
 
         _forward = glm::normalize(glm::rotateY(_forward, elapsedAngle));
+        _owner->dirty(ForwardField);
         if (auto bb = _owner->boundingBox())
         {
             bb->rotate(elapsedAngle);
@@ -59,9 +72,22 @@ void MotionMaster::update(uint64_t elapsed)
 
     if (!_generator && isMoving())
     {
+        auto from = _position;
         _position += _forward * (_speed * elapsed);
+        travelled(from);
+    }
+}
 
-        // TODO(gpascualg): This can be throttled, no need to do cell-changer per tick
+void MotionMaster::travelled(const glm::vec3& from)
+{
+    _owner->dirty(PositionField);
+
+    // The L1 distance is an upper bound of the real one, without a sqrt
+    _cellSlack -= std::abs(_position.x - from.x) + std::abs(_position.z - from.z);
+
+    // Only go through the map when the cell might have been left
+    if (_cellSlack < 0)
+    {
         Server::get()->map()->onMove(_owner);
     }
 }
@@ -70,6 +96,8 @@ void MotionMaster::teleport(glm::vec3 to)
 {
     _position = to;
     _flags = 0;
+    _cellSlack = 0;
+    _owner->dirty(PositionField);
 }
 
 void MotionMaster::move()
@@ -92,6 +120,13 @@ void MotionMaster::stop(bool cleanup)
 void MotionMaster::speed(float speed)
 {
     _speed = speed / 1000.0f;
+    _owner->dirty(SpeedField);
+}
+
+void MotionMaster::forward(glm::vec3 forward)
+{
+    _forward = forward;
+    _owner->dirty(ForwardField);
 }
 
 void MotionMaster::forward(float speed)
@@ -11,6 +11,7 @@ INCL_NOWARN
 INCL_WARN
 
 class MapAwareEntity;
+class MotionBatch;
 class MovementGenerator;
 
 
@@ -25,6 +26,8 @@ enum class MovementFlags
 
 class MotionMaster
 {
+    friend class MotionBatch;
+
 public:
     explicit MotionMaster(MapAwareEntity* owner);
 
@@ -33,7 +36,7 @@ public:
     inline const glm::vec2 position2D() { return { _position.x, _position.z }; }
 
     void forward(float speed);
-    void forward(glm::vec3 forward) { _forward = forward; }
+    void forward(glm::vec3 forward);
     inline const glm::vec3& forward() { return _forward; }
 
     void speed(float speed);
@@ -45,6 +48,10 @@ public:
     inline bool isMoving() { return (_flags & (uint8_t)MovementFlags::MOVING) == (uint8_t)MovementFlags::MOVING; }
     inline bool isRotating() { return (_flags & (uint8_t)MovementFlags::ROTATING) == (uint8_t)MovementFlags::ROTATING; }
 
+    // Distance that can be travelled before the cell might have to change
+    inline float cellSlack() { return _cellSlack; }
+    inline void cellSlack(float slack) { _cellSlack = slack; }
+
     inline MovementGenerator* generator() { return _generator; }
     void generator(MovementGenerator* generator) { _generator = generator; }
     void update(uint64_t elapsed);
@@ -59,4 +66,8 @@ private:
     float _rotationAngle;
 
     float _speed;
+    float _cellSlack;
+
+private:
+    void travelled(const glm::vec3& from);
 };
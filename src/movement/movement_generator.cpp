@@ -2,13 +2,48 @@
 
 #include "movement/movement_generator.hpp"
 #include "debug/debug.hpp"
+#include "defs/random.hpp"
+#include "io/bit_stream.hpp"
+#include "io/packet_schema.hpp"
 #include "map/map.hpp"
 #include "map/map_aware_entity.hpp"
 #include "movement/motion_master.hpp"
 #include "server/server.hpp"
 #include "physics/bounding_box.hpp"
 
-#include <random>
+
+// Entity id, new speed and starting point
+using SpeedChangeSchema = PacketSchema<uint64_t, uint8_t, glm::vec2>;
+
+// Reserved, the four control points and the current curve parameter
+using BezierSchema = PacketSchema<uint32_t, glm::vec2, glm::vec2, glm::vec2, glm::vec2, float>;
+
+// Control points are quantized relative to the start, up to this far away
+constexpr float CurvePositionRange = 1024.0f;
+
+// Bits of the quantized curve parameter
+constexpr uint8_t ParameterBits = 16;
+
+static inline void writeFloat(BitWriter& writer, float value)
+{
+    writer.write(f2u{ value }.u, 32);  // NOLINT(whitespace/braces)
+}
+
+static inline void writePoint(BitWriter& writer, const glm::vec2& point, const glm::vec2& origin)
+{
+    if (RandomMovement::encoding() & QuantizedPositions)
+    {
+        writer.writePosition(point, origin, CurvePositionRange);
+    }
+    else
+    {
+        writeFloat(writer, point.x);
+        writeFloat(writer, point.y);
+    }
+}
+
+
+uint8_t RandomMovement::_encoding = RawFields;
 
 
 MovementGenerator::~MovementGenerator()
@@ -27,11 +62,79 @@ RandomMovement::~RandomMovement()
 boost::intrusive_ptr<Packet> RandomMovement::packet()
 {
     // TODO(gpascualg): assert hasNext()
-    Packet* broadcast = Packet::create(0x0A05);
-    *broadcast << (uint32_t)0;
-    *broadcast << _bezier->start() << _bezier->startOffset();
-    *broadcast << _bezier->end() << _bezier->endOffset();
-    *broadcast << _t;
+    if (_encoding == RawFields)
+    {
+        return BezierSchema::create(0x0A05,
+            0,
+            _bezier->start(), _bezier->startOffset(),
+            _bezier->end(), _bezier->endOffset(),
+            _bezier->parameter(_t)
+        );  // NOLINT(whitespace/parens)
+    }
+
+    Packet* broadcast = Packet::create(0x0A15, BezierSchema::Size);
+    BitWriter writer(broadcast);
+    writer.write(_encoding, 8);
+
+    auto start = _bezier->start();
+    if (_encoding & QuantizedPositions)
+    {
+        writer.writeCellPosition(start);
+    }
+    else
+    {
+        writePoint(writer, start, {});
+    }
+
+    writePoint(writer, _bezier->startOffset(), start);
+    writePoint(writer, _bezier->end(), start);
+    writePoint(writer, _bezier->endOffset(), start);
+
+    if (_encoding & QuantizedParameter)
+    {
+        writer.writeQuantized(_bezier->parameter(_t), 0.0f, 1.0f, ParameterBits);
+    }
+    else
+    {
+        writeFloat(writer, _bezier->parameter(_t));
+    }
+
+    writer.flush();
+    return broadcast;
+}
+
+Packet* RandomMovement::speedPacket(MapAwareEntity* owner, uint8_t speed)
+{
+    if (_encoding == RawFields)
+    {
+        return SpeedChangeSchema::create(0x0A04, owner->id(), speed, _bezier->start());
+    }
+
+    Packet* broadcast = Packet::create(0x0A14, SpeedChangeSchema::Size);
+    BitWriter writer(broadcast);
+    writer.write(_encoding, 8);
+
+    if (_encoding & VarintIds)
+    {
+        writer.writeVarint(owner->id());
+    }
+    else
+    {
+        writer.write(owner->id(), 64);
+    }
+
+    writer.write(speed, 8);
+
+    if (_encoding & QuantizedPositions)
+    {
+        writer.writeCellPosition(_bezier->start());
+    }
+    else
+    {
+        writePoint(writer, _bezier->start(), {});
+    }
+
+    writer.flush();
     return broadcast;
 }
 
@@ -39,45 +142,36 @@ glm::vec3 RandomMovement::update(MapAwareEntity* owner, float elapsed)
 {
     if (!_hasPoint)
     {
-        // TODO(gpascualg): Move this out to somewhere else
-        static std::default_random_engine randomEngine;
-        static std::uniform_real_distribution<> speedDist(2, 10);
-        static std::uniform_real_distribution<> negativeDistanceDist(-400.0f, -250.0f);
-        static std::uniform_real_distribution<> positiveDistanceDist(250.0f, 400.0f);
-        static std::uniform_real_distribution<> positionDist(100.0f, 200.0f);
-        static std::uniform_real_distribution<> normal(0, 1);
-        static std::bernoulli_distribution coin;
-
-        uint8_t newSpeed = static_cast<uint8_t>(speedDist(randomEngine));
+        // Seeded from the entity and tick, thus independent of the updating thread
+        auto random = Random::forEntity(owner->id(), Server::get()->tick());
+        uint8_t newSpeed = static_cast<uint8_t>(random.uniform(2, 10));
 
         auto position = owner->motionMaster()->position();
         auto forward = owner->motionMaster()->forward();
 
+        // Draws are sequenced explicitly, argument evaluation order is unspecified
+        float endX = random.uniform(100.0f, 200.0f);
+        float endY = random.uniform(100.0f, 200.0f);
+        float startDistance = random.uniform(250.0f, 400.0f);
+        float endForwardX = random.real();
+        float endForwardY = random.real();
+        float endDistance = random.uniform(250.0f, 400.0f);
+
         glm::vec2 start = { position.x, position.z };
-        glm::vec2 end = glm::vec2 {  // NOLINT(whitespace/braces)
-            start.x + static_cast<float>(positionDist(randomEngine)),
-            start.y + static_cast<float>(positionDist(randomEngine))
-        };  // NOLINT(whitespace/braces)
-
-        _bezier = new DerivativeBezier(
-            start,
-            start + glm::vec2{ forward.x, forward.z } *    // NOLINT(whitespace/braces)
-                static_cast<float>(positiveDistanceDist(randomEngine)),  // StartOffset
-            end + glm::vec2{                               // NOLINT(whitespace/braces)
-                    -forward.x * normal(randomEngine),     // NOLINT(whitespace/braces)
-                    -forward.z * normal(randomEngine) } *  // NOLINT(whitespace/braces)
-                static_cast<float>(positiveDistanceDist(randomEngine)),
-            end
-        );  // NOLINT(whitespace/parens)
+        glm::vec2 end = { start.x + endX, start.y + endY };  // NOLINT(whitespace/braces)
+
+        glm::vec2 startControl = start + glm::vec2{ forward.x, forward.z } * startDistance;  // NOLINT(whitespace/braces)
+        glm::vec2 endControl = end + glm::vec2{ -forward.x * endForwardX, -forward.z * endForwardY } * endDistance;  // NOLINT(whitespace/braces)
+
+        // Same shaped paths, wherever they start, share their table
+        _bezier = new UniformBezier(start, startControl, endControl, end, ArcLengthCache::get(start, startControl, endControl, end));
 
         _t = 0;
         _previous = _bezier->start();
 
         // TODO(gpascualg): Move this to somewhere else
         // HACK(gpascualg): Packet opcode is not known yet!
-        Packet* broadcast = Packet::create(0x0A04);
-        *broadcast << owner->id() << newSpeed;
-        *broadcast << _bezier->start();
+        Packet* broadcast = speedPacket(owner, newSpeed);
 
         Server::get()->map()->broadcastToSiblings(owner->cell(), broadcast);
         _hasPoint = true;
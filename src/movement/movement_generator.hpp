@@ -3,12 +3,17 @@
 #pragma once
 
 #include "defs/intrusive.hpp"
+#include "movement/arc_length.hpp"
 #include <boost/intrusive_ptr.hpp>
 
+#include <cstddef>
+#include <memory>
+
 #include "defs/common.hpp"
 
 INCL_NOWARN
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 INCL_WARN
 
 
@@ -16,6 +21,17 @@ class Bezier;
 class MapAwareEntity;
 class Packet;
 
+// Fields RandomMovement sends compacted, through a BitWriter
+// Any of them switches 0x0A04/0x0A05 to 0x0A14/0x0A15, which carry these
+// flags as their first byte.
+enum MovementEncoding : uint8_t
+{
+    RawFields           = 0x00,
+    VarintIds           = 0x01,
+    QuantizedPositions  = 0x02,
+    QuantizedParameter  = 0x04
+};
+
 class MovementGenerator
 {
 public:
@@ -37,7 +53,16 @@ public:
     glm::vec3 update(MapAwareEntity* owner, float elapsed) override;
     bool hasNext() override;
 
+    // MovementEncoding flags, shared by all random movements
+    static inline uint8_t encoding() { return _encoding; }
+    static inline void encoding(uint8_t encoding) { _encoding = encoding; }
+
 private:
+    Packet* speedPacket(MapAwareEntity* owner, uint8_t speed);
+
+private:
+    static uint8_t _encoding;
+
     bool _hasPoint;
 
     Bezier* _bezier;
@@ -58,6 +83,9 @@ public:
     virtual glm::vec2 next(float t) = 0;
     virtual float increase(float t, float speed) = 0;
 
+    // Actual curve parameter, for those beziers that reparametrize t
+    virtual float parameter(float t) { return t; }
+
     inline glm::vec2 start() { return _a; }
     inline glm::vec2 startOffset() { return _b; }
     inline glm::vec2 endOffset() { return _c; }
@@ -118,6 +146,11 @@ public:
         return calc(map(t));
     }
 
+    float parameter(float t) override
+    {
+        return map(t);
+    }
+
 protected:
     float map(float t)
     {
@@ -187,3 +220,49 @@ protected:
     glm::vec2 _dv2;
     glm::vec2 _dv3;
 };
+
+
+// Constant speed bezier, t is the travelled fraction of its length
+// Its arc-length table is either built once or shared through ArcLengthCache
+class UniformBezier : public Bezier
+{
+public:
+    UniformBezier(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d) :
+        Bezier(a, b, c, d),
+        _table(std::make_shared<const ArcLengthTable>(a, b, c, d))
+    {}
+
+    UniformBezier(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d, std::shared_ptr<const ArcLengthTable> table) :
+        Bezier(a, b, c, d),
+        _table(std::move(table))
+    {}
+
+    float increase(float t, float speed) override
+    {
+        return speed / std::max(_table->length(), glm::epsilon<float>());
+    }
+
+    glm::vec2 next(float t) override
+    {
+        return calc(_table->parameter(t));
+    }
+
+    float parameter(float t) override
+    {
+        return _table->parameter(t);
+    }
+
+    inline float length() { return _table->length(); }
+
+    // Evaluates many curves at once (ie. all wandering entities of a cell)
+    static void evaluate(UniformBezier* const* curves, const float* t, glm::vec2* out, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            out[i] = curves[i]->calc(curves[i]->_table->parameter(t[i]));
+        }
+    }
+
+protected:
+    std::shared_ptr<const ArcLengthTable> _table;
+};
@@ -0,0 +1,195 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "pathfinding/flow_field.hpp"
+#include "map/cell.hpp"
+#include "map/map.hpp"
+#include "map/map_aware_entity.hpp"
+#include "movement/motion_master.hpp"
+#include "server/server.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+FlowField::FlowField(Pathfinder* pathfinder, MapAwareEntity* target, int32_t radius) :
+    _pathfinder(pathfinder),
+    _targetId(target->id()),
+    _radius(radius),
+    _target(nullptr),
+    _layer(nullptr),
+    _builds(0)
+{
+    auto position = target->motionMaster()->position2D();
+    auto offset = target->cell() ? target->cell()->offset() : offsetOf(position.x, position.y);
+    _seenQ = offset.q();
+    _seenR = offset.r();
+}
+
+void FlowField::refresh()
+{
+    auto target = find();
+    _target = target;
+
+    auto cell = target ? target->cell() : nullptr;
+    if (!cell)
+    {
+        std::atomic_store(&_layer, std::shared_ptr<const Layer>());
+        return;
+    }
+
+    const Offset& goal = cell->offset();
+    auto grid = _pathfinder->grid();
+
+    auto current = std::atomic_load(&_layer);
+    if (!current || current->goalQ != goal.q() || current->goalR != goal.r() || current->grid != grid)
+    {
+        std::atomic_store(&_layer, build(goal, grid));
+    }
+}
+
+MapAwareEntity* FlowField::find()
+{
+    Map* map = Server::get()->map();
+
+    for (int32_t i = -1; i < MAX_DIR_IDX; ++i)
+    {
+        int32_t q = _seenQ + (i < 0 ? 0 : directions[i].q);
+        int32_t r = _seenR + (i < 0 ? 0 : directions[i].r);
+
+        Cell* cell = map->get(q, r);
+        if (!cell)
+        {
+            continue;
+        }
+
+        auto it = cell->entities().find(_targetId);
+        if (it != cell->entities().end())
+        {
+            _seenQ = q;
+            _seenR = r;
+            return it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+bool FlowField::next(const glm::vec2& position, glm::vec2* waypoint)
+{
+    auto current = std::atomic_load(&_layer);
+    if (!current)
+    {
+        return false;
+    }
+
+    auto offset = offsetOf(position.x, position.y);
+    int32_t idx = index(*current, offset.q(), offset.r());
+    if (idx < 0)
+    {
+        *waypoint = Offset(current->goalQ, current->goalR).center();
+        return true;
+    }
+
+    int8_t direction = current->direction[idx];
+    if (direction == MAX_DIR_IDX)
+    {
+        // Already at the target cell
+        auto target = this->target();
+        if (!target)
+        {
+            return false;
+        }
+
+        *waypoint = target->motionMaster()->position2D();
+        return true;
+    }
+
+    if (direction < 0)
+    {
+        return false;
+    }
+
+    auto& step = directions[direction];
+    *waypoint = Offset(offset.q() + step.q, offset.r() + step.r).center();
+    return true;
+}
+
+std::shared_ptr<const FlowField::Layer> FlowField::build(const Offset& goal, std::shared_ptr<const CostGrid> grid)
+{
+    ++_builds;
+
+    int32_t side = 2 * _radius + 1;
+    auto layer = std::make_shared<Layer>();
+    layer->goalQ = goal.q();
+    layer->goalR = goal.r();
+    layer->grid = grid;
+    layer->cost.assign(side * side, std::numeric_limits<float>::infinity());
+    layer->direction.assign(side * side, -1);
+
+    // Dijkstra outwards from the goal, the cost of a cell is the cost of
+    // entering all cells up to (and including) the goal
+    using Entry = std::pair<float, int32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+    int32_t goalIdx = index(*layer, goal.q(), goal.r());
+    layer->cost[goalIdx] = 0;
+    layer->direction[goalIdx] = MAX_DIR_IDX;
+    open.emplace(0.0f, goalIdx);
+
+    while (!open.empty())
+    {
+        auto entry = open.top();
+        open.pop();
+
+        int32_t idx = entry.second;
+        if (entry.first > layer->cost[idx])
+        {
+            continue;
+        }
+
+        int32_t q = goal.q() + idx / side - _radius;
+        int32_t r = goal.r() + idx % side - _radius;
+        float enter = idx == goalIdx ? 1.0f : cellCost(*grid, Offset(q, r).hash());
+
+        for (int32_t i = 0; i < MAX_DIR_IDX; ++i)
+        {
+            int32_t nq = q + directions[i].q;
+            int32_t nr = r + directions[i].r;
+            int32_t next = index(*layer, nq, nr);
+            if (next < 0 || cellCost(*grid, Offset(nq, nr).hash()) == ObstacleCost)
+            {
+                continue;
+            }
+
+            float cost = entry.first + enter;
+            if (cost < layer->cost[next])
+            {
+                layer->cost[next] = cost;
+
+                // Neighbours walk back the opposite direction
+                layer->direction[next] = static_cast<int8_t>((i + MAX_DIR_IDX / 2) % MAX_DIR_IDX);
+                open.emplace(cost, next);
+            }
+        }
+    }
+
+    return layer;
+}
+
+int32_t FlowField::index(const Layer& layer, int32_t q, int32_t r)
+{
+    int32_t dq = q - layer.goalQ;
+    int32_t dr = r - layer.goalR;
+    if (Offset(q, r).distance(Offset(layer.goalQ, layer.goalR)) > _radius)
+    {
+        return -1;
+    }
+
+    return (dq + _radius) * (2 * _radius + 1) + (dr + _radius);
+}
@@ -0,0 +1,78 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include "map/offset.hpp"
+#include "pathfinding/pathfinder.hpp"
+
+#include <inttypes.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+class MapAwareEntity;
+
+// Cells around the target covered by a flow field
+constexpr int32_t DefaultFlowFieldRadius = 12;
+
+// Dijkstra field towards one target, shared by all its followers
+// The target and the field are resolved once per tick by the pathfinder, which
+// only rebuilds the field when the target changes cell or the grid changes.
+// Followers merely load what was published, thus following costs the same for
+// one or many. The target is looked up by id where it was last seen, or around
+// it, thus a destroyed (or teleported) target is simply reported as gone.
+class FlowField
+{
+private:
+    struct Layer
+    {
+        int32_t goalQ;
+        int32_t goalR;
+        std::shared_ptr<const CostGrid> grid;
+
+        // Dense (2 * radius + 1)^2 box around the goal
+        std::vector<float> cost;
+        std::vector<int8_t> direction;
+    };
+
+public:
+    FlowField(Pathfinder* pathfinder, MapAwareEntity* target, int32_t radius = DefaultFlowFieldRadius);
+    FlowField(const FlowField& field) = delete;
+
+    // Point to head to from `position`, false if the target can not be reached
+    // Outside of the field the target cell is targeted in straight line
+    bool next(const glm::vec2& position, glm::vec2* waypoint);
+
+    // Looks the target up and rebuilds the field if needed, not thread-safe
+    // Called by the pathfinder on each tick, before entities are updated
+    void refresh();
+
+    // Target as of the last refresh, only valid until the next map operations
+    inline MapAwareEntity* target() { return _target; }
+    inline uint64_t targetId() { return _targetId; }
+    inline int32_t radius() { return _radius; }
+    inline uint32_t builds() { return _builds; }
+
+private:
+    MapAwareEntity* find();
+    std::shared_ptr<const Layer> build(const Offset& goal, std::shared_ptr<const CostGrid> grid);
+    int32_t index(const Layer& layer, int32_t q, int32_t r);
+
+private:
+    Pathfinder* _pathfinder;
+    uint64_t _targetId;
+    int32_t _radius;
+
+    int32_t _seenQ;
+    int32_t _seenR;
+    std::atomic<MapAwareEntity*> _target;
+    std::shared_ptr<const Layer> _layer;  // Only accessed through std::atomic_load/store
+    std::atomic<uint32_t> _builds;
+};
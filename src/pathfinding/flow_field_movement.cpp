@@ -0,0 +1,69 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "pathfinding/flow_field_movement.hpp"
+#include "io/packet_schema.hpp"
+#include "map/map_aware_entity.hpp"
+#include "movement/motion_master.hpp"
+
+#include <algorithm>
+#include <utility>
+
+
+FlowFieldMovement::FlowFieldMovement(std::shared_ptr<FlowField> field, float distance) :
+    _field(std::move(field)),
+    _distance(distance),
+    _finished(false)
+{}
+
+FlowFieldMovement::~FlowFieldMovement()
+{}
+
+boost::intrusive_ptr<Packet> FlowFieldMovement::packet()
+{
+    // Reserved and target id
+    return PacketSchema<uint32_t, uint64_t>::create(0x0A07, 0, _field->targetId());
+}
+
+glm::vec3 FlowFieldMovement::update(MapAwareEntity* owner, float elapsed)
+{
+    auto motionMaster = owner->motionMaster();
+    auto position = motionMaster->position();
+    glm::vec2 current{ position.x, position.z };  // NOLINT(whitespace/braces)
+
+    glm::vec2 waypoint;
+    auto target = _field->target();
+    if (!target || !_field->next(current, &waypoint))
+    {
+        motionMaster->stop();
+        _finished = true;
+        return position;
+    }
+
+    // Wait around the target until it moves away
+    if (glm::distance(current, target->motionMaster()->position2D()) <= _distance)
+    {
+        motionMaster->stop();
+        return position;
+    }
+
+    if (!motionMaster->isMoving())
+    {
+        motionMaster->move();
+    }
+
+    auto delta = waypoint - current;
+    float left = glm::length(delta);
+    if (left > 0)
+    {
+        auto forward = delta / left;
+        current += forward * std::min(motionMaster->speed() * elapsed, left);
+        motionMaster->forward(glm::vec3{ forward.x, motionMaster->forward().y, forward.y });  // NOLINT(whitespace/braces)
+    }
+
+    return { current.x, position.y, current.y };
+}
+
+bool FlowFieldMovement::hasNext()
+{
+    return !_finished;
+}
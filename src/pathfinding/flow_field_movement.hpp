@@ -0,0 +1,34 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include "movement/movement_generator.hpp"
+#include "pathfinding/flow_field.hpp"
+
+#include <memory>
+
+#include "defs/common.hpp"
+
+
+// Distance at which followers stop around their target
+constexpr float DefaultFollowDistance = 2.0f;
+
+// Chases the target of a flow field, until stopped or the target is gone
+class FlowFieldMovement : public MovementGenerator
+{
+public:
+    explicit FlowFieldMovement(std::shared_ptr<FlowField> field, float distance = DefaultFollowDistance);
+    virtual ~FlowFieldMovement();
+
+    boost::intrusive_ptr<Packet> packet() override;
+    glm::vec3 update(MapAwareEntity* owner, float elapsed) override;
+    bool hasNext() override;
+
+    inline void stop() { _finished = true; }
+    inline FlowField* field() { return _field.get(); }
+
+private:
+    std::shared_ptr<FlowField> _field;
+    float _distance;
+    bool _finished;
+};
@@ -0,0 +1,123 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "pathfinding/path_movement.hpp"
+#include "debug/debug.hpp"
+#include "io/packet_schema.hpp"
+#include "map/map.hpp"
+#include "map/map_aware_entity.hpp"
+#include "movement/motion_master.hpp"
+#include "server/server.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+
+PathMovement::PathMovement(std::future<PathPtr>&& path) :
+    _future(std::move(path)),
+    _path(nullptr),
+    _next(1),
+    _finished(false)
+{}
+
+PathMovement::~PathMovement()
+{}
+
+boost::intrusive_ptr<Packet> PathMovement::packet()
+{
+    // Nothing to send until the pathfinder has answered
+    if (!_path)
+    {
+        return nullptr;
+    }
+
+    std::size_t count = std::min(_path->size() - std::min(_next, _path->size()), MaxPathPacketPoints);
+
+    // Reserved and number of points, followed by the points themselves
+    using Header = PacketSchema<uint32_t, uint16_t>;
+    using Point = WireField<glm::vec2>;
+
+    Packet* broadcast = Packet::create(0x0A06, Header::Size + count * Point::Size);
+    Header::write(broadcast, 0, static_cast<uint16_t>(count));
+
+    uint8_t* out = broadcast->claim(count * Point::Size);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        out = Point::write(out, (*_path)[_next + i]);
+    }
+    return broadcast;
+}
+
+glm::vec3 PathMovement::update(MapAwareEntity* owner, float elapsed)
+{
+    auto motionMaster = owner->motionMaster();
+    auto position = motionMaster->position();
+
+    if (!_path)
+    {
+        if (_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return position;
+        }
+
+        // The first waypoint is the cell we are already in
+        _path = _future.get();
+        if (_path->size() > 1)
+        {
+            // Siblings are told the whole route once, then follow it locally
+            if (owner->cell())
+            {
+                auto pathPacket = packet();
+                *pathPacket << owner->id();
+                Server::get()->map()->broadcastToSiblings(owner->cell(), pathPacket);
+            }
+
+            motionMaster->move();
+        }
+    }
+
+    // Position is only applied while there is something next, thus the
+    // generator finishes on the update after the last waypoint is reached
+    if (_next >= _path->size())
+    {
+        LOG(LOG_MOVEMENT_GENERATOR, "Path End");
+
+        motionMaster->stop();
+        _finished = true;
+        return position;
+    }
+
+    float distance = motionMaster->speed() * elapsed;
+    glm::vec2 current{ position.x, position.z };  // NOLINT(whitespace/braces)
+    glm::vec2 forward{ motionMaster->forward().x, motionMaster->forward().z };  // NOLINT(whitespace/braces)
+
+    while (distance > 0 && _next < _path->size())
+    {
+        auto delta = (*_path)[_next] - current;
+        float left = glm::length(delta);
+        if (left > 0)
+        {
+            forward = delta / left;
+        }
+
+        if (left <= distance)
+        {
+            current = (*_path)[_next];
+            distance -= left;
+            ++_next;
+        }
+        else
+        {
+            current += forward * distance;
+            distance = 0;
+        }
+    }
+
+    motionMaster->forward(glm::vec3{ forward.x, motionMaster->forward().y, forward.y });  // NOLINT(whitespace/braces)
+    return { current.x, position.y, current.y };
+}
+
+bool PathMovement::hasNext()
+{
+    return !_finished;
+}
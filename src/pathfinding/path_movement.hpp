@@ -0,0 +1,39 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include "movement/movement_generator.hpp"
+#include "pathfinding/pathfinder.hpp"
+
+#include <future>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+// Waypoints sent at most on each path packet
+constexpr std::size_t MaxPathPacketPoints = 64;
+
+// Follows a path from the Pathfinder, at the motion master speed
+// The entity stays still until the (asynchronous) path is ready
+class PathMovement : public MovementGenerator
+{
+public:
+    explicit PathMovement(std::future<PathPtr>&& path);
+    virtual ~PathMovement();
+
+    boost::intrusive_ptr<Packet> packet() override;
+    glm::vec3 update(MapAwareEntity* owner, float elapsed) override;
+    bool hasNext() override;
+
+    inline bool ready() { return _path != nullptr; }
+
+private:
+    std::future<PathPtr> _future;
+    PathPtr _path;
+    std::size_t _next;
+    bool _finished;
+};
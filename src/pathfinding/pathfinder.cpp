@@ -0,0 +1,448 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "pathfinding/pathfinder.hpp"
+#include "pathfinding/flow_field.hpp"
+#include "map/map_aware_entity.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+
+#include "defs/common.hpp"
+
+
+// Expansions a thread takes from the shared budget at once
+constexpr uint32_t ExpansionsChunk = 64;
+
+
+Pathfinder::Pathfinder(uint8_t numThreads, uint32_t budget) :
+    _budget(budget),
+    _available(0),
+    _stop(false),
+    _grid(std::make_shared<const Grid>()),
+    _version(0),
+    _requests(MaxQueuedPaths)
+{
+    for (int i = 0; i < numThreads; ++i)
+    {
+        _threads.emplace_back(std::thread([this] { run(); }));
+    }
+}
+
+Pathfinder::~Pathfinder()
+{
+    stop();
+    for (auto&& thread : _threads)
+    {
+        thread.join();
+    }
+
+    // Pending futures get a broken promise
+    Request* request;
+    while (_requests.pop(request))
+    {
+        delete request;
+    }
+}
+
+void Pathfinder::cost(const Offset& offset, float cost)
+{
+    {
+        std::lock_guard<std::mutex> lock(_gridMutex);
+        auto grid = std::make_shared<Grid>(*_grid);
+        (*grid)[offset.hash()] = std::max(cost, 1.0f);
+        _grid = grid;
+        ++_version;
+    }
+
+    clearCache();
+}
+
+float Pathfinder::cost(const Offset& offset)
+{
+    std::lock_guard<std::mutex> lock(_gridMutex);
+    return cellCost(*_grid, offset.hash());
+}
+
+std::shared_ptr<const CostGrid> Pathfinder::grid()
+{
+    std::lock_guard<std::mutex> lock(_gridMutex);
+    return _grid;
+}
+
+std::shared_ptr<FlowField> Pathfinder::flowField(MapAwareEntity* target)
+{
+    std::lock_guard<std::mutex> lock(_flowFieldsMutex);
+
+    auto it = _flowFields.find(target->id());
+    if (it != _flowFields.end())
+    {
+        if (auto field = it->second.lock())
+        {
+            return field;
+        }
+    }
+
+    auto field = std::make_shared<FlowField>(this, target);
+    field->refresh();
+    _flowFields[target->id()] = field;
+    return field;
+}
+
+void Pathfinder::obstacle(const Offset& offset, bool blocked)
+{
+    {
+        std::lock_guard<std::mutex> lock(_gridMutex);
+        auto grid = std::make_shared<Grid>(*_grid);
+        if (blocked)
+        {
+            (*grid)[offset.hash()] = ObstacleCost;
+        }
+        else
+        {
+            grid->erase(offset.hash());
+        }
+        _grid = grid;
+        ++_version;
+    }
+
+    clearCache();
+}
+
+bool Pathfinder::isObstacle(const Offset& offset)
+{
+    return cost(offset) == ObstacleCost;
+}
+
+std::future<PathPtr> Pathfinder::request(const glm::vec2& start, const glm::vec2& goal)
+{
+    return request(offsetOf(start.x, start.y), offsetOf(goal.x, goal.y));
+}
+
+std::future<PathPtr> Pathfinder::request(const Offset& start, const Offset& goal)
+{
+    auto request = new Request();
+    auto future = request->promise.get_future();
+
+    if (auto path = cached({ start.hash(), goal.hash() }))  // NOLINT(whitespace/braces)
+    {
+        request->promise.set_value(path);
+        delete request;
+        return future;
+    }
+
+    request->startQ = start.q();
+    request->startR = start.r();
+    request->goalQ = goal.q();
+    request->goalR = goal.r();
+    request->expansions = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_gridMutex);
+        request->grid = _grid;
+        request->version = _version;
+    }
+
+    // Queue full, consider using more threads or a bigger budget
+    // Reported as unreachable rather than leaving the future pending forever
+    if (!_requests.bounded_push(request))
+    {
+        request->promise.set_value(std::make_shared<const Path>());
+        delete request;
+        return future;
+    }
+
+    notify();
+    return future;
+}
+
+std::size_t Pathfinder::cacheSize()
+{
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    return _cache.size();
+}
+
+void Pathfinder::tick()
+{
+    // A new generation, chunks granted before can not be given back anymore
+    _available = (((_available >> 32) + 1) << 32) | _budget;
+
+    refreshFlowFields();
+
+    if (!_threads.empty())
+    {
+        notify();
+        return;
+    }
+
+    // No dedicated threads, solve as much as the budget allows right now
+    uint32_t budget = _budget;
+    Request* request;
+    while (budget > 0 && _requests.pop(request))
+    {
+        if (search(request, &budget))
+        {
+            delete request;
+        }
+        else
+        {
+            _requests.push(request);
+        }
+    }
+}
+
+void Pathfinder::refreshFlowFields()
+{
+    std::lock_guard<std::mutex> lock(_flowFieldsMutex);
+
+    // Followers only load the result, and fields nobody follows are dropped
+    for (auto it = _flowFields.begin(); it != _flowFields.end();)
+    {
+        if (auto field = it->second.lock())
+        {
+            field->refresh();
+            ++it;
+        }
+        else
+        {
+            it = _flowFields.erase(it);
+        }
+    }
+}
+
+void Pathfinder::stop()
+{
+    _stop = true;
+    notify();
+}
+
+void Pathfinder::notify()
+{
+    std::lock_guard<std::mutex> lock(_signalMutex);
+    _signal.notify_all();
+}
+
+void Pathfinder::run()
+{
+    Request* request = nullptr;
+
+    while (!_stop)
+    {
+        if (!request && !_requests.pop(request))
+        {
+            request = nullptr;
+        }
+
+        // Take a chunk of this tick's budget
+        uint32_t granted = 0;
+        uint64_t available = _available;
+        if (request)
+        {
+            do
+            {
+                granted = static_cast<uint32_t>(std::min<uint64_t>(available & 0xFFFFFFFF, ExpansionsChunk));
+            }
+            while (granted > 0 && !_available.compare_exchange_weak(available, available - granted));
+        }
+
+        if (granted == 0)
+        {
+            std::unique_lock<std::mutex> lock(_signalMutex);
+            _signal.wait(lock, [this, request]
+                {
+                    return _stop || ((request || !_requests.empty()) && (_available & 0xFFFFFFFF) > 0);
+                }
+            );  // NOLINT(whitespace/parens)
+            continue;
+        }
+
+        uint32_t budget = granted;
+        if (search(request, &budget))
+        {
+            delete request;
+            request = nullptr;
+        }
+
+        // Give back whatever was not used, unless the budget has been refilled since
+        uint64_t generation = available >> 32;
+        available = _available;
+        while (budget > 0 && (available >> 32) == generation && !_available.compare_exchange_weak(available, available + budget))
+        {}
+    }
+
+    delete request;
+}
+
+bool Pathfinder::search(Request* request, uint32_t* budget)
+{
+    const Offset goal(request->goalQ, request->goalR);
+    const uint64_t goalHash = goal.hash();
+    auto& grid = *request->grid;
+    auto& open = request->open;
+    auto& nodes = request->nodes;
+
+    if (nodes.empty())
+    {
+        const Offset start(request->startQ, request->startR);
+        if (cellCost(grid, goalHash) == ObstacleCost)
+        {
+            finish(request, goalHash, true);
+            return true;
+        }
+
+        nodes.emplace(start.hash(), Node { start.q(), start.r(), 0, start.hash(), false });  // NOLINT(whitespace/braces)
+        open.emplace_back(static_cast<float>(start.distance(goal)), start.hash());
+    }
+
+    while (!open.empty())
+    {
+        if (*budget == 0)
+        {
+            return false;
+        }
+
+        std::pop_heap(open.begin(), open.end(), std::greater<std::pair<float, uint64_t>>());
+        uint64_t hash = open.back().second;
+        open.pop_back();
+
+        Node& node = nodes.at(hash);
+        if (node.closed)
+        {
+            continue;
+        }
+
+        node.closed = true;
+        --*budget;
+
+        if (hash == goalHash)
+        {
+            break;
+        }
+
+        // A path might still exist, thus it is not cached
+        if (++request->expansions >= MaxPathExpansions)
+        {
+            finish(request, goalHash, false);
+            return true;
+        }
+
+        for (auto& direction : directions)
+        {
+            const Offset next(node.q + direction.q, node.r + direction.r);
+            float cost = cellCost(grid, next.hash());
+            if (cost == ObstacleCost)
+            {
+                continue;
+            }
+
+            float g = node.g + cost;
+            auto current = nodes.find(next.hash());
+            if (current == nodes.end())
+            {
+                nodes.emplace(next.hash(), Node { next.q(), next.r(), g, hash, false });  // NOLINT(whitespace/braces)
+            }
+            else if (!current->second.closed && g < current->second.g)
+            {
+                current->second.g = g;
+                current->second.parent = hash;
+            }
+            else
+            {
+                continue;
+            }
+
+            open.emplace_back(g + next.distance(goal), next.hash());
+            std::push_heap(open.begin(), open.end(), std::greater<std::pair<float, uint64_t>>());
+        }
+    }
+
+    finish(request, goalHash, true);
+    return true;
+}
+
+void Pathfinder::finish(Request* request, uint64_t goal, bool cacheable)
+{
+    auto path = std::make_shared<Path>();
+
+    // Unreachable goals leave an empty path
+    auto it = request->nodes.find(goal);
+    if (it != request->nodes.end() && it->second.closed)
+    {
+        uint64_t hash = goal;
+        while (true)
+        {
+            auto& node = request->nodes.at(hash);
+            path->push_back(Offset(node.q, node.r).center());
+
+            if (node.parent == hash)
+            {
+                break;
+            }
+            hash = node.parent;
+        }
+
+        std::reverse(path->begin(), path->end());
+    }
+
+    if (cacheable)
+    {
+        const Offset start(request->startQ, request->startR);
+        cache({ start.hash(), goal }, path, request->version);  // NOLINT(whitespace/braces)
+    }
+    request->promise.set_value(path);
+
+    // Free search memory as soon as possible
+    request->nodes.clear();
+    request->open.clear();
+    request->grid.reset();
+}
+
+PathPtr Pathfinder::cached(const CacheKey& key)
+{
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+
+    auto it = _cache.find(key);
+    if (it == _cache.end())
+    {
+        return nullptr;
+    }
+
+    // Most recently used go first
+    _lru.splice(_lru.begin(), _lru, it->second);
+    return it->second->second;
+}
+
+void Pathfinder::cache(const CacheKey& key, PathPtr path, uint32_t version)
+{
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+
+    // The grid has changed since the search started
+    if (version != _version)
+    {
+        return;
+    }
+
+    auto it = _cache.find(key);
+    if (it != _cache.end())
+    {
+        _lru.erase(it->second);
+        _cache.erase(it);
+    }
+
+    _lru.emplace_front(key, path);
+    _cache.emplace(key, _lru.begin());
+
+    if (_lru.size() > DefaultPathCacheSize)
+    {
+        _cache.erase(_lru.back().first);
+        _lru.pop_back();
+    }
+}
+
+void Pathfinder::clearCache()
+{
+    std::lock_guard<std::mutex> lock(_cacheMutex);
+    _cache.clear();
+    _lru.clear();
+}
@@ -0,0 +1,166 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include "map/offset.hpp"
+
+#include <inttypes.h>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <boost/functional/hash.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+class FlowField;
+class MapAwareEntity;
+
+// Cell centers, from the start cell to the goal cell (empty if unreachable)
+using Path = std::vector<glm::vec2>;
+using PathPtr = std::shared_ptr<const Path>;
+
+// Node expansions shared by all pathfinding threads on each tick
+constexpr uint32_t DefaultPathfinderBudget = 4096;
+
+// Searches giving up after this many expansions report no path, which is not
+// cached as there might be one
+constexpr uint32_t MaxPathExpansions = 8192;
+
+// Number of (start, goal) results kept around
+constexpr std::size_t DefaultPathCacheSize = 256;
+
+// Requests waiting to be solved, further ones are reported unreachable
+constexpr std::size_t MaxQueuedPaths = 256;
+
+// Entry cost of cells that can not be walked
+constexpr float ObstacleCost = std::numeric_limits<float>::infinity();
+
+// Cost of entering each cell, unknown cells cost 1
+using CostGrid = std::unordered_map<uint64_t /*hash*/, float>;
+
+inline float cellCost(const CostGrid& grid, uint64_t hash)
+{
+    auto it = grid.find(hash);
+    return it != grid.end() ? it->second : 1.0f;
+}
+
+// A* over the hex grid, run asynchronously
+// Requests are queued from any thread and solved by dedicated threads, which
+// together never expand more than `budget` nodes per tick. Without threads,
+// requests are solved inside `tick` itself.
+class Pathfinder
+{
+private:
+    using Grid = CostGrid;
+    using CacheKey = std::pair<uint64_t, uint64_t>;
+
+    struct Node
+    {
+        int32_t q;
+        int32_t r;
+        float g;
+        uint64_t parent;
+        bool closed;
+    };
+
+    struct Request
+    {
+        int32_t startQ;
+        int32_t startR;
+        int32_t goalQ;
+        int32_t goalR;
+
+        std::promise<PathPtr> promise;
+
+        // Resumable search state
+        std::shared_ptr<const Grid> grid;
+        uint32_t version;
+        uint32_t expansions;
+        std::vector<std::pair<float, uint64_t>> open;
+        std::unordered_map<uint64_t, Node> nodes;
+    };
+
+public:
+    explicit Pathfinder(uint8_t numThreads, uint32_t budget = DefaultPathfinderBudget);
+    Pathfinder(const Pathfinder& pathfinder) = delete;
+    virtual ~Pathfinder();
+
+    // Walkability, costs below 1 are clamped to keep the heuristic admissible
+    void cost(const Offset& offset, float cost);
+    float cost(const Offset& offset);
+    void obstacle(const Offset& offset, bool blocked = true);
+    bool isObstacle(const Offset& offset);
+
+    // Thread-safe, cached paths are immediately available
+    std::future<PathPtr> request(const Offset& start, const Offset& goal);
+    std::future<PathPtr> request(const glm::vec2& start, const glm::vec2& goal);
+
+    // Shared by all entities chasing the same target
+    std::shared_ptr<FlowField> flowField(MapAwareEntity* target);
+
+    // Current grid snapshot, never modified once returned
+    std::shared_ptr<const CostGrid> grid();
+
+    // Refills the expansions budget and refreshes flow fields, called once per
+    // map update before entities are updated
+    void tick();
+
+    inline uint32_t budget() { return _budget; }
+    inline void budget(uint32_t budget) { _budget = budget; }
+
+    std::size_t cacheSize();
+    void clearCache();
+
+    void stop();
+
+private:
+    void run();
+
+    // Returns true once the request has been fulfilled
+    bool search(Request* request, uint32_t* budget);
+    void finish(Request* request, uint64_t goal, bool cacheable);
+    void notify();
+    void refreshFlowFields();
+
+    PathPtr cached(const CacheKey& key);
+    void cache(const CacheKey& key, PathPtr path, uint32_t version);
+
+private:
+    uint32_t _budget;
+    std::atomic<uint64_t> _available;  // Tick generation (high half) and expansions left (low half)
+    std::atomic<bool> _stop;
+
+    // Copy-on-write grid, searches keep the snapshot they started with
+    std::mutex _gridMutex;
+    std::shared_ptr<const Grid> _grid;
+    std::atomic<uint32_t> _version;
+
+    // LRU of recent results
+    std::mutex _cacheMutex;
+    std::list<std::pair<CacheKey, PathPtr>> _lru;
+    std::unordered_map<CacheKey, decltype(_lru)::iterator, boost::hash<CacheKey>> _cache;
+
+    // Live flow fields, by target id
+    std::mutex _flowFieldsMutex;
+    std::unordered_map<uint64_t, std::weak_ptr<FlowField>> _flowFields;
+
+    boost::lockfree::queue<Request*> _requests;
+    std::vector<std::thread> _threads;
+
+    std::mutex _signalMutex;
+    std::condition_variable _signal;
+};
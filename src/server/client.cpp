@@ -2,11 +2,20 @@
 
 #include "server/client.hpp"
 #include "debug/debug.hpp"
+#include "debug/reactive.hpp"
 #include "server/server.hpp"
+#include "server/transport.hpp"
+#include "server/udp_transport.hpp"
 #include "io/packet.hpp"
 #include "map/cell.hpp"
 #include "map/map.hpp"
 #include "map/map_aware_entity.hpp"
+#include "movement/movement_generator.hpp"
+
+#include <string.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "defs/common.hpp"
 
@@ -17,12 +26,66 @@ INCL_WARN
 
 using tcp = boost::asio::ip::tcp;
 
+// Entity id of compact speed changes, right after the encoding flags
+static uint64_t compactMovementId(Packet* packet)
+{
+    if (!(packet->peek<uint8_t>(4) & VarintIds))
+    {
+        return packet->peek<uint64_t>(5);
+    }
+
+    uint64_t id = 0;
+    for (uint16_t i = 0; i < 10; ++i)
+    {
+        uint8_t group = packet->peek<uint8_t>(5 + i);
+        id |= static_cast<uint64_t>(group & 0x7F) << (7 * i);
+        if (!(group & 0x80))
+        {
+            break;
+        }
+    }
+
+    return id;
+}
+
+static uint64_t trailingId(Packet* packet)
+{
+    return packet->peek<uint64_t>(packet->written() - sizeof(uint64_t));
+}
+
+// Movement updates and snapshots only matter in their latest version
+std::unordered_map<uint16_t, ReplaceKey> Client::_replaceable =
+{
+    { 0x0A04, [](Packet* packet) { return packet->peek<uint64_t>(4); } },
+    { 0x0A05, trailingId },
+    { 0x0A14, compactMovementId },
+    { 0x0A15, trailingId },
+    { SnapshotOpcode, [](Packet* packet) { return uint64_t{ 0 }; } },  // NOLINT(whitespace/braces)
+    { InputAckOpcode, [](Packet* packet) { return uint64_t{ 0 }; } }  // NOLINT(whitespace/braces)
+};  // NOLINT(whitespace/braces)
+
 Client::Client(boost::asio::io_service* io_service, uint64_t id) :
+    _strand(*io_service),
+    _inFlight(0),
     _status(Status::INITIALIZED),
     _socket(*io_service),
-    _timer(*io_service)
+    _timer(*io_service),
+    _recvBegin(0),
+    _recvEnd(0),
+    _deliveryBudget(DefaultDeliveryBudget),
+    _delivered(0),
+    _outboundBytes(0),
+    _overflow(false),
+    _token(0),
+    _udpBound(false),
+    _transport(nullptr),
+    _fd(-1),
+    _written(0),
+    _releasing(false),
+    _released(false)
 {
     _packet = Packet::create();
+    _view = Packet::create();
     _entity = Server::get()->newMapAwareEntity(id, this);
 
     LOG(LOG_CLIENT_LIFECYCLE, "New client %" PRId64, id);
@@ -33,7 +96,10 @@ Client::~Client()
     LOG(LOG_CLIENT_LIFECYCLE, "Deleted client %" PRId64, id());
 
     _packet->destroy();
+    _view->destroy();
     Server::get()->destroyMapAwareEntity(_entity);
+
+    Reactive::get()->onOutboundReleased(_outboundBytes);
 }
 
 uint64_t Client::id()
@@ -46,20 +112,99 @@ bool Client::inMap()
     return _entity->cell() != nullptr;
 }
 
+void Client::native(Transport* transport, int fd)
+{
+    _transport = transport;
+    _fd = fd;
+}
+
+bool Client::release()
+{
+    // Aborted operations still run their handlers, which refer to us
+    if (!_transport)
+    {
+        return _inFlight == 0;
+    }
+
+    if (!_releasing)
+    {
+        _releasing = true;
+        _transport->release(this);
+    }
+
+    return _released && _inFlight == 0;
+}
+
 void Client::scheduleRead(uint16_t bytesToRead, bool reset)
 {
-    // Cancel timeout
-    _timer.cancel();
+    LOG_ASSERT(!_transport, "Native transports only support streaming reads");
+
+    // Might be called from outside the strand (ie. on accept)
+    ++_inFlight;
+    _strand.dispatch([this, bytesToRead, reset]()
+        {
+            // Read reset?
+            if (reset)
+            {
+                _readTimes = 0;
+                _packet->reset();
+            }
 
-    // Read reset?
-    if (reset)
+            // Start read
+            ++_inFlight;
+            boost::asio::async_read(_socket, _packet->recvBuffer(bytesToRead), _strand.wrap(
+                [this](const boost::system::error_code& error, size_t size)
+                {
+                    if (error == boost::asio::error::eof)
+                    {
+                        LOG(LOG_CLIENT_LIFECYCLE, "Closed: %" PRId64, time(NULL));
+                        close();
+                    }
+                    else if (!error)
+                    {
+                        ++_readTimes;
+                        _packet->addSize((uint16_t)size);
+                        Server::get()->handleRead(this, error, size);
+                    }
+                    // Note: boost::asio::error::operation_aborted when cancel()
+
+                    --_inFlight;
+                }
+            ));  // NOLINT(whitespace/parens)
+
+            resetTimeout();
+            --_inFlight;
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+void Client::startReading()
+{
+    // Nothing is read until attached, no need for the strand
+    if (_transport)
     {
-        _readTimes = 0;
-        _packet->reset();
+        _recv.resize(ReceiveBufferSize);
+        _recvBegin = _recvEnd = 0;
+        _transport->attach(this);
+        return;
     }
 
-    // Start read
-    boost::asio::async_read(_socket, _packet->recvBuffer(bytesToRead),
+    ++_inFlight;
+    _strand.dispatch([this]()
+        {
+            _recv.resize(ReceiveBufferSize);
+            _recvBegin = _recvEnd = 0;
+            readSome();
+            --_inFlight;
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+void Client::readSome()
+{
+    auto buffer = boost::asio::buffer(_recv.data() + _recvEnd, _recv.size() - _recvEnd);
+    ++_inFlight;
+    _socket.async_read_some(buffer, _strand.wrap(
         [this](const boost::system::error_code& error, size_t size)
         {
             if (error == boost::asio::error::eof)
@@ -69,49 +214,514 @@ void Client::scheduleRead(uint16_t bytesToRead, bool reset)
             }
             else if (!error)
             {
-                ++_readTimes;
-                _packet->addSize((uint16_t)size);
-                Server::get()->handleRead(this, error, size);
+                _recvEnd += size;
+                if (splitFrames())
+                {
+                    readSome();
+                }
             }
             // Note: boost::asio::error::operation_aborted when cancel()
+
+            --_inFlight;
         }
-    );  // NOLINT(whitespace/parens)
+    ));  // NOLINT(whitespace/parens)
+
+    resetTimeout();
+}
+
+bool Client::splitFrames()
+{
+    constexpr std::size_t HeaderSize = sizeof(uint16_t) * 2;
+
+    while (_recvEnd - _recvBegin >= HeaderSize)
+    {
+        uint8_t* frame = _recv.data() + _recvBegin;
+        uint16_t length;
+        memcpy(&length, frame + sizeof(uint16_t), sizeof(uint16_t));
+        std::size_t size = HeaderSize + length;
+
+        // Would never fit in a packet, the stream can not be trusted anymore
+        if (size > Packet::MaxSize)
+        {
+            LOG(LOG_CLIENT_LIFECYCLE, "Client %" PRId64 " sent a frame too big", id());
+            close();
+            return false;
+        }
+
+        if (_recvEnd - _recvBegin < size)
+        {
+            break;
+        }
+
+        // No copies, the view is only valid during the call
+        _view->view(frame, static_cast<uint16_t>(size));
+        dispatch(_view);
+        _recvBegin += size;
+    }
+
+    // Move the trailing partial frame, if any, to the front
+    std::size_t pending = _recvEnd - _recvBegin;
+    if (pending > 0 && _recvBegin > 0)
+    {
+        memmove(_recv.data(), _recv.data() + _recvBegin, pending);
+    }
+
+    _recvBegin = 0;
+    _recvEnd = pending;
+    return _status != Status::CLOSED;
+}
+
+void Client::dispatch(Packet* frame)
+{
+    try
+    {
+        // Engine frames never reach the server, whichever way they came
+        uint16_t opcode = frame->peek<uint16_t>(0);
+        if (opcode == SnapshotAckOpcode)
+        {
+            if (frame->size() < sizeof(uint16_t) * 2 + sizeof(uint64_t))
+            {
+                LOG(LOG_PACKET_RECV, "Malformed snapshot ack");
+                close();
+                return;
+            }
+
+            _replication.ack(frame->peek<uint64_t>(4));
+            return;
+        }
+
+        if (opcode == InputBatchOpcode)
+        {
+            if (!_inputs.push(frame, Server::get()->tick()))
+            {
+                LOG(LOG_PACKET_RECV, "Malformed input batch");
+                close();
+            }
+            return;
+        }
+
+        Server::get()->handleFrame(this, frame);
+    }
+    catch (const ReadOutOfBounds&)
+    {
+        // The stream can not be trusted anymore
+        LOG(LOG_PACKET_RECV, "Client %" PRId64 " sent a malformed frame", id());
+        close();
+    }
+}
 
-    // Setup timeout!
-    _timer.expires_from_now(boost::posix_time::seconds(30));
-    _timer.async_wait([this] (const boost::system::error_code& error)
+void Client::resetTimeout()
+{
+    // Setup timeout! (Setting the expiration cancels the previous one)
+    _timer.expires_from_now(boost::posix_time::seconds(ClientTimeout));
+    ++_inFlight;
+    _timer.async_wait(_strand.wrap([this] (const boost::system::error_code& error)
         {
             if (!error)
             {
                 LOG(LOG_CLIENT_LIFECYCLE, "Timeout: %" PRId64, time(NULL));
                 close();
             }
+
+            --_inFlight;
         }
-    );  // NOLINT(whitespace/parens)
+    ));  // NOLINT(whitespace/parens)
+}
+
+void Client::replaceable(uint16_t opcode, ReplaceKey key)
+{
+    _replaceable[opcode] = key;
+}
+
+void Client::snapshot(uint64_t tick)
+{
+    if (_status != Status::CLOSED && inMap())
+    {
+        send(_replication.snapshot(_entity, tick));
+    }
+}
+
+void Client::acknowledge()
+{
+    if (_status != Status::CLOSED)
+    {
+        if (auto packet = _inputs.acknowledge())
+        {
+            send(packet);
+        }
+    }
 }
 
 void Client::send(boost::intrusive_ptr<Packet> packet)
 {
+    LOG(LOG_PACKET_SEND, "Queueing %04X", packet->peek<uint16_t>(0));
+
+    // Lengths are fixed here, never while flushing, as the same packet might
+    // be flushed to several clients at once
+    packet->finalize();
+
+    {
+        std::lock_guard<std::mutex> lock(_queuedMutex);
+        _queued.push_back(packet);
+    }
+
+    account(packet->written());
+}
+
+void Client::cut()
+{
+    {
+        std::lock_guard<std::mutex> lock(_queuedMutex);
+        if (_cut.empty())
+        {
+            std::swap(_cut, _queued);
+        }
+        else
+        {
+            _cut.insert(_cut.end(), _queued.begin(), _queued.end());
+            _queued.clear();
+        }
+    }
+
+    // A new budget, those deferred the longest go first
+    _delivered = 0;
+    if (_deferred.empty())
+    {
+        return;
+    }
+
+    std::vector<boost::intrusive_ptr<Packet>> deferred;
+    std::swap(deferred, _deferred);
+    _deferredIdx.clear();
+
+    uint32_t bytes = 0;
+    for (auto& packet : deferred)
+    {
+        if (budgeted(packet))
+        {
+            _cut.push_back(packet);
+            bytes += packet->written();
+        }
+    }
+
+    account(bytes);
+}
+
+void Client::deliver(const std::list<boost::intrusive_ptr<Packet>>& packets)
+{
+    uint32_t bytes = 0;
+    for (auto& packet : packets)
+    {
+        if (budgeted(packet))
+        {
+            _cut.push_back(packet);
+            bytes += packet->written();
+        }
+    }
+
+    account(bytes);
+}
+
+bool Client::budgeted(const boost::intrusive_ptr<Packet>& packet)
+{
+    // Reliable packets (ie. spawns) always go through
     uint16_t opcode = packet->peek<uint16_t>(0);
-    LOG(LOG_PACKET_SEND, "Sending %04X", opcode);
+    auto policy = _replaceable.find(opcode);
+    if (!_deliveryBudget || policy == _replaceable.end())
+    {
+        return true;
+    }
+
+    // Still waiting its turn, it keeps its place with the newer version
+    auto key = std::make_pair(opcode, policy->second(packet.get()));
+    auto it = _deferredIdx.find(key);
+    if (it != _deferredIdx.end())
+    {
+        _deferred[it->second] = packet;
+        return false;
+    }
+
+    // At least one per tick, however big
+    if (_delivered && _delivered + packet->written() > _deliveryBudget)
+    {
+        _deferredIdx[key] = _deferred.size();
+        _deferred.push_back(packet);
+        return false;
+    }
+
+    _delivered += packet->written();
+    return true;
+}
+
+void Client::account(uint32_t bytes)
+{
+    _outboundBytes += bytes;
+    Reactive::get()->onOutboundQueued(bytes);
+
+    // Too far behind, it is not going to catch up
+    if (_outboundBytes > OutboundHardLimit && !_overflow.exchange(true))
+    {
+        LOG(LOG_CLIENT_LIFECYCLE, "Client %" PRId64 " outbound overflow", id());
+        Reactive::get()->onOutboundOverflow();
+
+        ++_inFlight;
+        _strand.post([this]()
+            {
+                close();
+                --_inFlight;
+            }
+        );  // NOLINT(whitespace/parens)
+    }
+}
+
+void Client::flush()
+{
+    std::vector<boost::intrusive_ptr<Packet>> packets;
+    std::swap(packets, _cut);
+    if (_status == Status::CLOSED)
+    {
+        return;
+    }
+
+    // Acks and resends go out even if there is nothing new
+    if (_udpBound)
+    {
+        writeDatagrams(packets);
+        return;
+    }
+
+    if (packets.empty())
+    {
+        return;
+    }
+
+    // Batched with every other flush of the tick
+    if (_transport)
+    {
+        _transport->submit(this, std::move(packets));
+        return;
+    }
+
+    ++_inFlight;
+    _strand.post([this, packets = std::move(packets)]()
+        {
+            for (auto& packet : packets)
+            {
+                enqueue(packet);
+            }
+
+            // Only one write may be in flight on a socket
+            if (_writing.empty())
+            {
+                write();
+            }
+
+            --_inFlight;
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+void Client::writeDatagrams(const std::vector<boost::intrusive_ptr<Packet>>& packets)
+{
+    uint32_t bytes = 0;
+    for (auto& packet : packets)
+    {
+        bool reliable = _replaceable.find(packet->peek<uint16_t>(0)) == _replaceable.end();
+        _session.send(packet, packet->framed() || reliable);
+        bytes += packet->written();
+    }
+
+    // Out of our hands, the session keeps what must be resent
+    _outboundBytes -= bytes;
+    Reactive::get()->onOutboundReleased(bytes);
+
+    // Never acked, it is not going to catch up either
+    if (_session.overflow())
+    {
+        if (!_overflow.exchange(true))
+        {
+            LOG(LOG_CLIENT_LIFECYCLE, "Client %" PRId64 " reliable overflow", id());
+            Reactive::get()->onOutboundOverflow();
+
+            ++_inFlight;
+            _strand.post([this]()
+                {
+                    close();
+                    --_inFlight;
+                }
+            );  // NOLINT(whitespace/parens)
+        }
+        return;
+    }
+
+    boost::asio::ip::udp::endpoint endpoint;
+    {
+        std::lock_guard<std::mutex> lock(_endpointMutex);
+        endpoint = _endpoint;
+    }
+
+    for (auto& datagram : _session.flush())
+    {
+        Server::get()->udp()->send(endpoint, datagram);
+    }
+}
 
-    boost::asio::async_write(socket(), packet->sendBuffer(),
-        [packet](const boost::system::error_code & error, std::size_t size)
+void Client::receive(boost::intrusive_ptr<Packet> datagram, const boost::asio::ip::udp::endpoint& from)
+{
+    ++_inFlight;
+    _strand.post([this, datagram, from]()
         {
-            LOG(LOG_PACKET_SEND, "\tPacket %04X sent!", packet->peek<uint16_t>(0));
+            if (_status != Status::CLOSED)
+            {
+                handleDatagram(datagram, from);
+            }
+
+            --_inFlight;
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+void Client::handleDatagram(boost::intrusive_ptr<Packet> datagram, const boost::asio::ip::udp::endpoint& from)
+{
+    // Each message holds one or more whole frames
+    bool valid = _session.receive(datagram->data(), datagram->written(), [this](uint8_t* data, uint16_t size)
+        {
+            constexpr uint16_t HeaderSize = sizeof(uint16_t) * 2;
+
+            while (size >= HeaderSize)
+            {
+                uint16_t length;
+                memcpy(&length, data + sizeof(uint16_t), sizeof(uint16_t));
+                if (length > size - HeaderSize)
+                {
+                    break;
+                }
+
+                _view->view(data, HeaderSize + length);
+                dispatch(_view);
+                data += HeaderSize + length;
+                size -= HeaderSize + length;
+            }
         }
     );  // NOLINT(whitespace/parens)
+
+    // Anyone might send garbage with a stolen token, just ignore it
+    if (!valid)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_endpointMutex);
+        _endpoint = from;
+    }
+
+    _udpBound = true;
+    resetTimeout();
+}
+
+void Client::enqueue(boost::intrusive_ptr<Packet> packet)
+{
+    uint16_t opcode = packet->peek<uint16_t>(0);
+    auto policy = _replaceable.find(opcode);
+
+    // Reliable packets (ie. spawns) are always kept
+    if (policy == _replaceable.end())
+    {
+        _outbound.push_back(packet);
+        return;
+    }
+
+    auto key = std::make_pair(opcode, policy->second(packet.get()));
+    auto it = _replaceableIdx.find(key);
+    if (it != _replaceableIdx.end() && _outboundBytes > OutboundSoftLimit)
+    {
+        auto& stale = _outbound[it->second];
+        _outboundBytes -= stale->written();
+        Reactive::get()->onOutboundReplaced(stale->written());
+
+        stale = packet;
+        return;
+    }
+
+    _replaceableIdx[key] = _outbound.size();
+    _outbound.push_back(packet);
+}
+
+void Client::write()
+{
+    if (_outbound.empty())
+    {
+        return;
+    }
+
+    std::swap(_writing, _outbound);
+    _replaceableIdx.clear();
+
+    _buffers.clear();
+    for (auto& packet : _writing)
+    {
+        _buffers.emplace_back(packet->data(), packet->written());
+    }
+
+    LOG(LOG_PACKET_SEND, "Sending %d packets", static_cast<int>(_writing.size()));
+
+    ++_inFlight;
+    boost::asio::async_write(socket(), _buffers, _strand.wrap(
+        [this](const boost::system::error_code& error, std::size_t size)
+        {
+            LOG(LOG_PACKET_SEND, "\t%d bytes sent!", static_cast<int>(size));
+
+            drop(&_writing);
+
+            if (!error)
+            {
+                write();
+            }
+
+            --_inFlight;
+        }
+    ));  // NOLINT(whitespace/parens)
+}
+
+void Client::drop(std::vector<boost::intrusive_ptr<Packet>>* packets)
+{
+    uint32_t bytes = 0;
+    for (auto& packet : *packets)
+    {
+        bytes += packet->written();
+    }
+
+    _outboundBytes -= bytes;
+    Reactive::get()->onOutboundReleased(bytes);
+    packets->clear();
 }
 
 void Client::close()
 {
-    if (_status != Status::CLOSED)
+    // Might be closed concurrently from the strand and the main thread
+    if (_status.exchange(Status::CLOSED) != Status::CLOSED)
     {
         LOG(LOG_CLIENT_LIFECYCLE, "Closed client %" PRId64, id());
 
-        // Cancel all IO
-        _timer.cancel();
-        _socket.close();
+        // Cancel all IO, socket and timer are only touched from the strand
+        // (or the transport thread)
+        if (_transport)
+        {
+            _transport->close(this);
+        }
+        else
+        {
+            ++_inFlight;
+            _strand.dispatch([this]()
+                {
+                    boost::system::error_code error;
+                    _timer.cancel(error);
+                    _socket.close(error);
+                    --_inFlight;
+                }
+            );  // NOLINT(whitespace/parens)
+        }
 
         // Remove from map
         auto cell = entity()->cell();
@@ -120,9 +730,6 @@ void Client::close()
             cell->map()->removeFrom(cell, entity(), nullptr);
         }
 
-        // Flag me
-        _status = Status::CLOSED;
-
         // Recycle client
         Server::get()->handleClose(this);
     }
@@ -2,16 +2,27 @@
 
 #pragma once
 
+#include "server/datagram.hpp"
+#include "server/input.hpp"
+#include "server/replication.hpp"
+
 #include <inttypes.h>
 #include <array>
+#include <atomic>
 #include <cstddef>
 #include <functional>
+#include <list>
+#include <mutex>
 #include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "defs/common.hpp"
 
 INCL_NOWARN
 #include <boost/asio.hpp>
+#include <boost/functional/hash.hpp>
 #include "defs/intrusive.hpp"
 #include <boost/intrusive_ptr.hpp>
 INCL_WARN
@@ -19,9 +30,30 @@ INCL_WARN
 
 class Packet;
 class MapAwareEntity;
+class Transport;
+
+// Outbound bytes after which stale replaceable packets are dropped
+constexpr uint32_t OutboundSoftLimit = 64 * 1024;
+
+// Outbound bytes after which the client is disconnected
+constexpr uint32_t OutboundHardLimit = 512 * 1024;
+
+// Bytes of replaceable broadcasts each client is delivered per tick
+constexpr uint32_t DefaultDeliveryBudget = 8 * 1024;
+
+// Bytes buffered for incoming frames, must hold at least one full packet
+constexpr std::size_t ReceiveBufferSize = 32 * 1024;
+
+// Seconds without receiving anything after which a client is closed
+constexpr uint16_t ClientTimeout = 30;
+
+// Identifies what a replaceable packet refers to (ie. the entity id)
+using ReplaceKey = std::function<uint64_t(Packet*)>;
 
 class Client
 {
+    friend class EpollTransport;
+
 public:
     enum class Status
     {
@@ -39,8 +71,81 @@ public:
     bool inMap();
 
     void scheduleRead(uint16_t bytesToRead, bool reset = false);
+
+    // Streaming alternative to scheduleRead, reads whatever is available and
+    // hands every complete frame to Server::handleFrame, but engine ones (ie.
+    // snapshot acks and input batches). Frames read out of bounds close the client
+    // The only one available to clients of a native transport
+    void startReading();
+
+    // Moves the client to a native transport, its asio socket stays unused
+    // Must be called before it is accepted (see Server::accept)
+    void native(Transport* transport, int fd);
+    inline Transport* transport() { return _transport; }
+
+    // Asks the transport to let go of a closed client, true once it has and
+    // no strand handler or socket operation refers to it anymore
+    // Must not be destroyed before
+    // NOT thread-safe, must be called from the map thread
+    bool release();
+
+    // Queues the packet, it is only written on the next flush
+    // Finalizes it, thus it must not be written into afterwards
     void send(boost::intrusive_ptr<Packet> packet);
 
+    // Ends the tick, packets sent up to now go out on the next flush and
+    // those sent afterwards on the one after it. Broadcasts deferred last
+    // tick go right behind them, oldest first, as the budget allows
+    // NOT thread-safe with flush/deliver, called once per tick
+    void cut();
+
+    // Appends a batch behind what has been cut, used by the fan-out stage
+    // Packets must already be finalized (see Cell::broadcast)
+    // Replaceable packets compete for the delivery budget, in the order they
+    // are delivered (ie. closest cells first). Those left out wait for the
+    // next tick, only in their latest version, the rest always go through
+    // NOT thread-safe, only from whoever flushes this client
+    void deliver(const std::list<boost::intrusive_ptr<Packet>>& packets);
+
+    // Bytes per tick, 0 for no limit
+    // NOT thread-safe, only from whoever flushes this client
+    inline uint32_t deliveryBudget() { return _deliveryBudget; }
+    inline void deliveryBudget(uint32_t bytes) { _deliveryBudget = bytes; }
+    inline std::size_t deferred() { return _deferred.size(); }
+
+    // Writes everything cut so far with a single gathered write
+    // The write itself happens on the client strand
+    void flush();
+
+    // Bytes queued but not yet written to the socket
+    inline uint32_t outboundBytes() { return _outboundBytes; }
+
+    // Queues a delta snapshot of the surroundings, if in the map
+    // NOT thread-safe, must be called from the map thread
+    void snapshot(uint64_t tick);
+    inline Replication* replication() { return &_replication; }
+
+    // UDP token, 0 if none was issued (see UdpTransport)
+    inline uint64_t token() { return _token; }
+    inline void token(uint64_t token) { _token = token; }
+
+    // Handles a datagram, without its token, on the client strand
+    // Counted as in flight right away, see UdpTransport::revoke
+    // Once one is valid, everything is sent over UDP: replaceable packets
+    // unreliably, the rest on the reliable channel
+    void receive(boost::intrusive_ptr<Packet> datagram, const boost::asio::ip::udp::endpoint& from);
+    inline bool datagrams() { return _udpBound; }
+
+    // Queues the ack of the last input applied, if any new
+    // NOT thread-safe, must be called from the map thread
+    void acknowledge();
+    inline InputQueue* inputs() { return &_inputs; }
+
+    // NOT thread-safe, register before starting the server
+    // Over the soft limit, a newer packet with the same opcode and key
+    // replaces the queued one instead of being appended
+    static void replaceable(uint16_t opcode, ReplaceKey key);
+
     inline Packet* packet() { return _packet; }
     inline uint8_t readPhase() { return _readTimes; }
     inline boost::asio::ip::tcp::socket& socket() { return _socket; }
@@ -53,11 +158,75 @@ public:
     virtual void close();
 
 private:
-    Status _status;
+    void write();
+    void drop(std::vector<boost::intrusive_ptr<Packet>>* packets);
+    void writeDatagrams(const std::vector<boost::intrusive_ptr<Packet>>& packets);
+    void account(uint32_t bytes);
+    void enqueue(boost::intrusive_ptr<Packet> packet);
+    bool budgeted(const boost::intrusive_ptr<Packet>& packet);
+
+    void readSome();
+    bool splitFrames();
+    void dispatch(Packet* frame);
+    void handleDatagram(boost::intrusive_ptr<Packet> datagram, const boost::asio::ip::udp::endpoint& from);
+    void resetTimeout();
+
+private:
+    boost::asio::io_service::strand _strand;
+    std::atomic<uint32_t> _inFlight;  // Strand handlers and asio operations
+    std::atomic<Status> _status;
     MapAwareEntity* _entity;
     boost::asio::ip::tcp::socket _socket;
     boost::asio::deadline_timer _timer;
 
     Packet* _packet;
     uint8_t _readTimes = 0;
+
+    // Streaming receive, [_recvBegin, _recvEnd) holds unparsed bytes
+    std::vector<uint8_t> _recv;
+    std::size_t _recvBegin;
+    std::size_t _recvEnd;
+    Packet* _view;
+
+    // Filled from any thread during the tick
+    std::mutex _queuedMutex;
+    std::vector<boost::intrusive_ptr<Packet>> _queued;
+
+    // Current tick, only touched by whoever cuts and flushes
+    std::vector<boost::intrusive_ptr<Packet>> _cut;
+
+    // Replaceable broadcasts over the budget, same as above
+    uint32_t _deliveryBudget;
+    uint32_t _delivered;
+    std::vector<boost::intrusive_ptr<Packet>> _deferred;
+    std::unordered_map<std::pair<uint16_t, uint64_t>, std::size_t, boost::hash<std::pair<uint16_t, uint64_t>>> _deferredIdx;
+
+    // Only touched from the strand
+    std::vector<boost::intrusive_ptr<Packet>> _outbound;
+    std::vector<boost::intrusive_ptr<Packet>> _writing;
+    std::vector<boost::asio::const_buffer> _buffers;
+    std::unordered_map<std::pair<uint16_t, uint64_t>, std::size_t, boost::hash<std::pair<uint16_t, uint64_t>>> _replaceableIdx;
+
+    std::atomic<uint32_t> _outboundBytes;
+    std::atomic<bool> _overflow;
+
+    Replication _replication;
+    InputQueue _inputs;
+
+    // UDP, the endpoint follows the last valid datagram
+    uint64_t _token;
+    std::atomic<bool> _udpBound;
+    std::mutex _endpointMutex;
+    boost::asio::ip::udp::endpoint _endpoint;
+    DatagramSession _session;
+
+    // Native transport, everything but release is only touched from it
+    Transport* _transport;
+    int _fd;
+    std::size_t _written;  // Of the packets being written
+    TimePoint _lastActivity;
+    bool _releasing;
+    std::atomic<bool> _released;
+
+    static std::unordered_map<uint16_t, ReplaceKey> _replaceable;
 };
@@ -0,0 +1,355 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "server/datagram.hpp"
+#include "io/packet.hpp"
+
+#include <string.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+// Token, sequence, ack and ack bits
+constexpr uint16_t DatagramHeaderBytes = sizeof(uint64_t) + sizeof(uint16_t) * 2 + sizeof(uint32_t);
+
+// Channel and length, plus the id if reliable
+constexpr uint16_t UnreliableOverhead = sizeof(uint8_t) + sizeof(uint16_t);
+constexpr uint16_t ReliableOverhead = UnreliableOverhead + sizeof(uint16_t);
+
+// Biggest payload a single message may carry
+constexpr uint16_t MaxFragmentBytes = MaxDatagramBytes - DatagramHeaderBytes - ReliableOverhead;
+
+// Sequence `a` comes after `b`, accounting for wrap around
+static inline bool newer(uint16_t a, uint16_t b)
+{
+    return static_cast<int16_t>(a - b) > 0;
+}
+
+DatagramSession::DatagramSession() :
+    _flushes(0),
+    _localSequence(0),
+    _nextReliable(0),
+    _receivedAny(false),
+    _ackPending(false),
+    _remoteSequence(0),
+    _remoteBits(0),
+    _expectedReliable(0),
+    _dropping(false)
+{
+    for (auto& flight : _inFlight)
+    {
+        flight.valid = false;
+    }
+}
+
+void DatagramSession::send(boost::intrusive_ptr<Packet> packet, bool reliable)
+{
+    const uint8_t* data = packet->data();
+    uint16_t size = packet->written();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!reliable && size <= MaxFragmentBytes)
+    {
+        _unreliable.emplace_back(data, data + size);
+        return;
+    }
+
+    uint16_t offset = 0;
+    do
+    {
+        uint16_t length = std::min<uint16_t>(MaxFragmentBytes, size - offset);
+        bool last = offset + length == size;
+
+        _pending.push_back({ _nextReliable++, last ? Reliable : ReliableFragment,  // NOLINT(whitespace/braces)
+            std::vector<uint8_t>(data + offset, data + offset + length), 0, false, false });  // NOLINT(whitespace/braces)
+        offset += length;
+    }
+    while (offset < size);
+}
+
+std::vector<boost::intrusive_ptr<Packet>> DatagramSession::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ++_flushes;
+
+    std::vector<boost::intrusive_ptr<Packet>> datagrams;
+    Packet* datagram = nullptr;
+    InFlight* flight = nullptr;
+
+    // Tokens are prepended later on, if at all
+    auto room = [&datagram](uint16_t bytes)
+        {
+            return datagram && datagram->written() + bytes <= MaxDatagramBytes - sizeof(uint64_t);
+        };  // NOLINT(whitespace/braces)
+
+    auto open = [this, &datagrams, &datagram, &flight]()
+        {
+            uint16_t sequence = _localSequence++;
+            datagram = Packet::create();
+            datagram->framed(true);
+            *datagram << sequence << _remoteSequence << _remoteBits;
+            datagrams.push_back(datagram);
+
+            flight = &_inFlight[sequence % DatagramHistory];
+            flight->sequence = sequence;
+            flight->valid = true;
+            flight->reliable.clear();
+        };  // NOLINT(whitespace/braces)
+
+    // Reliable first, resending those not acked in a while
+    uint16_t oldest = _pending.empty() ? 0 : _pending.front().id;
+    for (auto& pending : _pending)
+    {
+        if (static_cast<uint16_t>(pending.id - oldest) >= ReliableWindow)
+        {
+            break;
+        }
+
+        if (pending.acked || (pending.sent && pending.sentAt + ReliableResendFlushes > _flushes))
+        {
+            continue;
+        }
+
+        uint16_t length = static_cast<uint16_t>(pending.data.size());
+        if (!room(ReliableOverhead + length))
+        {
+            open();
+        }
+
+        *datagram << static_cast<uint8_t>(pending.channel) << pending.id << length;
+        memcpy(datagram->claim(length), pending.data.data(), length);
+        flight->reliable.push_back(pending.id);
+
+        pending.sent = true;
+        pending.sentAt = _flushes;
+    }
+
+    for (auto& message : _unreliable)
+    {
+        uint16_t length = static_cast<uint16_t>(message.size());
+        if (!room(UnreliableOverhead + length))
+        {
+            open();
+        }
+
+        *datagram << static_cast<uint8_t>(Unreliable) << length;
+        memcpy(datagram->claim(length), message.data(), length);
+    }
+
+    _unreliable.clear();
+
+    // Nothing to say, but the other end expects its acks
+    if (datagrams.empty() && _ackPending)
+    {
+        open();
+    }
+
+    _ackPending = false;
+    return datagrams;
+}
+
+bool DatagramSession::receive(uint8_t* data, uint16_t size, Deliver deliver)
+{
+    constexpr uint16_t HeaderBytes = sizeof(uint16_t) * 2 + sizeof(uint32_t);
+    if (size < HeaderBytes)
+    {
+        return false;
+    }
+
+    // Validate everything before touching any state
+    uint8_t* end = data + size;
+    for (uint8_t* in = data + HeaderBytes; in < end;)
+    {
+        uint8_t channel = *in;
+        uint16_t overhead = channel == Unreliable ? UnreliableOverhead : ReliableOverhead;
+        if (channel > ReliableFragment || end - in < overhead)
+        {
+            return false;
+        }
+
+        uint16_t length;
+        memcpy(&length, in + overhead - sizeof(uint16_t), sizeof(uint16_t));
+        if (end - in - overhead < length)
+        {
+            return false;
+        }
+
+        in += overhead + length;
+    }
+
+    uint16_t sequence;
+    uint16_t ack;
+    uint32_t bits;
+    memcpy(&sequence, data, sizeof(uint16_t));
+    memcpy(&ack, data + sizeof(uint16_t), sizeof(uint16_t));
+    memcpy(&bits, data + sizeof(uint16_t) * 2, sizeof(uint32_t));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Duplicated or too old, but not malformed
+    bool newest;
+    if (!received(sequence, &newest))
+    {
+        return true;
+    }
+
+    // Acks alone are not acked back, or both ends would never stop
+    acked(ack, bits);
+    _ackPending = _ackPending || size > HeaderBytes;
+
+    for (uint8_t* in = data + HeaderBytes; in < end;)
+    {
+        Channel channel = static_cast<Channel>(*in);
+        uint16_t id = 0;
+        uint16_t length;
+
+        if (channel == Unreliable)
+        {
+            memcpy(&length, in + sizeof(uint8_t), sizeof(uint16_t));
+            in += UnreliableOverhead;
+
+            // Something newer already went through
+            if (newest)
+            {
+                deliver(in, length);
+            }
+        }
+        else
+        {
+            memcpy(&id, in + sizeof(uint8_t), sizeof(uint16_t));
+            memcpy(&length, in + sizeof(uint8_t) + sizeof(uint16_t), sizeof(uint16_t));
+            in += ReliableOverhead;
+
+            deliverReliable(id, channel, in, length, deliver);
+        }
+
+        in += length;
+    }
+
+    return true;
+}
+
+bool DatagramSession::overflow()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _pending.size() > MaxPendingReliable;
+}
+
+void DatagramSession::acked(uint16_t ack, uint32_t bits)
+{
+    for (uint16_t i = 0; i <= 32; ++i)
+    {
+        if (i > 0 && !(bits & (1u << (i - 1))))
+        {
+            continue;
+        }
+
+        uint16_t sequence = ack - i;
+        auto& flight = _inFlight[sequence % DatagramHistory];
+        if (!flight.valid || flight.sequence != sequence)
+        {
+            continue;
+        }
+
+        for (auto id : flight.reliable)
+        {
+            uint16_t idx = id - (_pending.empty() ? id : _pending.front().id);
+            if (idx < _pending.size())
+            {
+                _pending[idx].acked = true;
+            }
+        }
+
+        flight.valid = false;
+    }
+
+    while (!_pending.empty() && _pending.front().acked)
+    {
+        _pending.pop_front();
+    }
+}
+
+bool DatagramSession::received(uint16_t sequence, bool* newest)
+{
+    *newest = true;
+
+    if (!_receivedAny)
+    {
+        _receivedAny = true;
+        _remoteSequence = sequence;
+        _remoteBits = 0;
+        return true;
+    }
+
+    if (newer(sequence, _remoteSequence))
+    {
+        uint16_t distance = sequence - _remoteSequence;
+        _remoteBits = distance > 32 ? 0 : ((distance == 32 ? 0 : _remoteBits << distance) | (1u << (distance - 1)));
+        _remoteSequence = sequence;
+        return true;
+    }
+
+    uint16_t distance = _remoteSequence - sequence;
+    if (distance == 0 || distance > 32 || (_remoteBits & (1u << (distance - 1))))
+    {
+        return false;
+    }
+
+    _remoteBits |= 1u << (distance - 1);
+    *newest = false;
+    return true;
+}
+
+void DatagramSession::deliverReliable(uint16_t id, Channel channel, uint8_t* data, uint16_t size, const Deliver& deliver)
+{
+    // Already delivered, or too far ahead to be buffered
+    uint16_t distance = id - _expectedReliable;
+    if (distance >= ReliableWindow)
+    {
+        return;
+    }
+
+    if (distance > 0)
+    {
+        _outOfOrder.emplace(id, std::make_pair(channel, std::vector<uint8_t>(data, data + size)));
+        return;
+    }
+
+    assemble(channel, data, size, deliver);
+    ++_expectedReliable;
+
+    // Whatever was waiting for it
+    for (auto it = _outOfOrder.find(_expectedReliable); it != _outOfOrder.end(); it = _outOfOrder.find(_expectedReliable))
+    {
+        auto& message = it->second;
+        assemble(message.first, message.second.data(), static_cast<uint16_t>(message.second.size()), deliver);
+        _outOfOrder.erase(it);
+        ++_expectedReliable;
+    }
+}
+
+void DatagramSession::assemble(Channel channel, uint8_t* data, uint16_t size, const Deliver& deliver)
+{
+    if (channel == Reliable && _fragments.empty() && !_dropping)
+    {
+        deliver(data, size);
+        return;
+    }
+
+    // Would never fit in a packet, drop it whole
+    if (_dropping || _fragments.size() + size > Packet::MaxSize)
+    {
+        _fragments.clear();
+        _dropping = channel == ReliableFragment;
+        return;
+    }
+
+    _fragments.insert(_fragments.end(), data, data + size);
+    if (channel == Reliable)
+    {
+        deliver(_fragments.data(), static_cast<uint16_t>(_fragments.size()));
+        _fragments.clear();
+    }
+}
@@ -0,0 +1,126 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include "defs/intrusive.hpp"
+#include <boost/intrusive_ptr.hpp>
+INCL_WARN
+
+
+class Packet;
+
+// Sent over TCP once accepted, with the token (u64) and UDP port (u16) to use
+constexpr uint16_t UdpTokenOpcode = 0x0B05;
+
+// Keeps datagrams below the usual path MTU
+constexpr uint16_t MaxDatagramBytes = 1200;
+
+// Sent datagrams remembered to match incoming acks against
+constexpr std::size_t DatagramHistory = 64;
+
+// Reliable messages in flight, and buffered out of order, at most
+constexpr uint16_t ReliableWindow = 256;
+
+// Flushes to wait for an ack before resending a reliable message
+constexpr uint8_t ReliableResendFlushes = 4;
+
+// Unacked reliable messages after which the session is considered dead
+constexpr std::size_t MaxPendingReliable = 4096;
+
+// One end of a UDP connection
+// Each datagram has a sequence number and acks the last one received, plus
+// the 32 before it as a bitfield. Messages are either unreliable, dropped if
+// lost or out of date, or reliable, resent until acked and delivered in order.
+// Reliable messages too big for a datagram are split into fragments.
+//
+// Datagram layout (clients prefix it with their u64 token):
+//  u16 sequence, u16 ack, u32 ack bits
+//  for each message: u8 channel, [u16 reliable id], u16 length, payload
+class DatagramSession
+{
+public:
+    enum Channel : uint8_t
+    {
+        Unreliable = 0,
+        Reliable = 1,
+        ReliableFragment = 2  // Reliable, more fragments follow
+    };
+
+    // Called for each complete message, the data is only valid during the call
+    using Deliver = std::function<void(uint8_t* data, uint16_t size)>;
+
+private:
+    struct Pending
+    {
+        uint16_t id;
+        Channel channel;
+        std::vector<uint8_t> data;
+        uint64_t sentAt;
+        bool sent;
+        bool acked;
+    };
+
+    struct InFlight
+    {
+        uint16_t sequence;
+        bool valid;
+        std::vector<uint16_t> reliable;
+    };
+
+public:
+    DatagramSession();
+    DatagramSession(const DatagramSession& session) = delete;
+
+    // Thread-safe, queues a whole packet (header included) on a channel
+    // Unreliable packets too big for a datagram go reliable
+    void send(boost::intrusive_ptr<Packet> packet, bool reliable);
+
+    // Thread-safe, datagrams to send now: new messages, resends and acks
+    std::vector<boost::intrusive_ptr<Packet>> flush();
+
+    // Thread-safe, but not concurrently with itself
+    // Returns false if the datagram is malformed
+    bool receive(uint8_t* data, uint16_t size, Deliver deliver);
+
+    // Thread-safe, too much reliable data is waiting for acks
+    bool overflow();
+
+private:
+    void acked(uint16_t ack, uint32_t bits);
+    bool received(uint16_t sequence, bool* newest);
+    void deliverReliable(uint16_t id, Channel channel, uint8_t* data, uint16_t size, const Deliver& deliver);
+    void assemble(Channel channel, uint8_t* data, uint16_t size, const Deliver& deliver);
+
+private:
+    std::mutex _mutex;
+    uint64_t _flushes;
+
+    // Outgoing
+    uint16_t _localSequence;
+    uint16_t _nextReliable;
+    std::deque<Pending> _pending;
+    std::vector<std::vector<uint8_t>> _unreliable;
+    std::array<InFlight, DatagramHistory> _inFlight;
+
+    // Incoming
+    bool _receivedAny;
+    bool _ackPending;
+    uint16_t _remoteSequence;
+    uint32_t _remoteBits;
+    uint16_t _expectedReliable;
+    std::map<uint16_t, std::pair<Channel, std::vector<uint8_t>>> _outOfOrder;
+    std::vector<uint8_t> _fragments;
+    bool _dropping;
+};
@@ -0,0 +1,452 @@
+/* Copyright 2016 Guillem Pascual */
+
+#ifdef __linux__
+
+#include "server/epoll_transport.hpp"
+#include "debug/debug.hpp"
+#include "io/packet.hpp"
+#include "server/client.hpp"
+#include "server/server.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+EpollTransport::EpollTransport(uint8_t numThreads) :
+    _listener(-1),
+    _stop(false)
+{
+    for (uint8_t i = 0; i < std::max<uint8_t>(numThreads, 1); ++i)
+    {
+        auto shard = std::make_unique<Shard>();
+        shard->epoll = epoll_create1(EPOLL_CLOEXEC);
+        shard->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        shard->iov.reserve(IOV_MAX);
+        shard->stopped = false;
+
+        LOG_ASSERT(shard->epoll >= 0 && shard->wakeup >= 0, "Could not create epoll set");
+
+        // Level-triggered, it is read on every wake up
+        epoll_event event {};  // NOLINT(whitespace/braces)
+        event.events = EPOLLIN;
+        event.data.ptr = shard.get();
+        epoll_ctl(shard->epoll, EPOLL_CTL_ADD, shard->wakeup, &event);
+
+        _shards.push_back(std::move(shard));
+    }
+}
+
+EpollTransport::~EpollTransport()
+{
+    stop();
+
+    for (auto& shard : _shards)
+    {
+        ::close(shard->epoll);
+        ::close(shard->wakeup);
+    }
+}
+
+void EpollTransport::start(int listener)
+{
+    _listener = listener;
+    fcntl(_listener, F_SETFL, fcntl(_listener, F_GETFL) | O_NONBLOCK);
+
+    // Only the first shard accepts
+    epoll_event event {};  // NOLINT(whitespace/braces)
+    event.events = EPOLLIN | EPOLLET;
+    event.data.ptr = &_listener;
+    epoll_ctl(_shards.front()->epoll, EPOLL_CTL_ADD, _listener, &event);
+
+    for (auto& shard : _shards)
+    {
+        Shard* raw = shard.get();
+        shard->thread = std::thread([this, raw] { run(raw); });
+    }
+}
+
+void EpollTransport::stop()
+{
+    if (_stop.exchange(true))
+    {
+        return;
+    }
+
+    for (auto& shard : _shards)
+    {
+        uint64_t one = 1;
+        ::write(shard->wakeup, &one, sizeof(one));
+
+        if (shard->thread.joinable())
+        {
+            shard->thread.join();
+        }
+
+        // Queued while it was exiting, and whatever comes later, or a release
+        // would never be acknowledged
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        shard->stopped = true;
+        for (auto& command : shard->commands)
+        {
+            execute(shard.get(), command);
+        }
+
+        shard->commands.clear();
+
+        // Clients outliving the transport keep their accounting, but not their sockets
+        for (auto client : shard->clients)
+        {
+            ::close(client->_fd);
+            client->_fd = -1;
+        }
+
+        shard->clients.clear();
+    }
+}
+
+void EpollTransport::attach(Client* client)
+{
+    push(client, CommandType::ATTACH);
+}
+
+void EpollTransport::submit(Client* client, std::vector<boost::intrusive_ptr<Packet>>&& packets)
+{
+    push(client, CommandType::SUBMIT, std::move(packets));
+}
+
+void EpollTransport::close(Client* client)
+{
+    push(client, CommandType::CLOSE);
+}
+
+void EpollTransport::release(Client* client)
+{
+    push(client, CommandType::RELEASE);
+}
+
+EpollTransport::Shard* EpollTransport::shard(Client* client)
+{
+    return _shards[client->id() % _shards.size()].get();
+}
+
+void EpollTransport::push(Client* client, CommandType type, std::vector<boost::intrusive_ptr<Packet>>&& packets)
+{
+    Shard* target = shard(client);
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(target->mutex);
+        if (target->stopped)
+        {
+            Command command { type, client, std::move(packets) };  // NOLINT(whitespace/braces)
+            execute(target, command);
+            return;
+        }
+
+        wake = target->commands.empty();
+        target->commands.push_back({ type, client, std::move(packets) });  // NOLINT(whitespace/braces)
+    }
+
+    // Otherwise a wake up is already on its way
+    if (wake)
+    {
+        uint64_t one = 1;
+        ::write(target->wakeup, &one, sizeof(one));
+    }
+}
+
+void EpollTransport::run(Shard* shard)
+{
+    std::array<epoll_event, MaxEpollEvents> events;
+    std::vector<Command> commands;
+    TimePoint lastSweep = std::chrono::high_resolution_clock::now();
+
+    while (!_stop)
+    {
+        int count = epoll_wait(shard->epoll, events.data(), MaxEpollEvents, EpollSweepInterval);
+
+        for (int i = 0; i < count; ++i)
+        {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &_listener)
+            {
+                acceptAll();
+            }
+            else if (ptr == shard)
+            {
+                uint64_t value;
+                ::read(shard->wakeup, &value, sizeof(value));
+            }
+            else
+            {
+                Client* client = static_cast<Client*>(ptr);
+                if (client->_fd < 0)
+                {
+                    continue;
+                }
+
+                // Pending data is still read, the end of stream closes it
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP))
+                {
+                    readAll(client);
+                }
+
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                {
+                    client->close();
+                }
+                else if (events[i].events & EPOLLOUT)
+                {
+                    writeAll(shard, client);
+                }
+            }
+        }
+
+        // Everything queued meanwhile, in order
+        drain(shard, &commands);
+
+        auto now = std::chrono::high_resolution_clock::now();
+        if (now - lastSweep >= std::chrono::milliseconds(EpollSweepInterval))
+        {
+            lastSweep = now;
+            sweep(shard);
+        }
+    }
+
+    // A release might have come along with the stop, it must not be lost
+    drain(shard, &commands);
+}
+
+void EpollTransport::drain(Shard* shard, std::vector<Command>* commands)
+{
+    {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        std::swap(*commands, shard->commands);
+    }
+
+    for (auto& command : *commands)
+    {
+        execute(shard, command);
+    }
+
+    commands->clear();
+}
+
+void EpollTransport::execute(Shard* shard, Command& command)
+{
+    Client* client = command.client;
+
+    switch (command.type)
+    {
+        case CommandType::ATTACH:
+            // Closed before being attached
+            if (client->_fd >= 0)
+            {
+                // Data already there is reported right away
+                epoll_event event {};  // NOLINT(whitespace/braces)
+                event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+                event.data.ptr = client;
+                epoll_ctl(shard->epoll, EPOLL_CTL_ADD, client->_fd, &event);
+
+                client->_lastActivity = std::chrono::high_resolution_clock::now();
+                shard->clients.insert(client);
+            }
+            break;
+
+        case CommandType::SUBMIT:
+            if (client->_fd < 0)
+            {
+                client->drop(&command.packets);
+                break;
+            }
+
+            for (auto& packet : command.packets)
+            {
+                client->enqueue(packet);
+            }
+
+            writeAll(shard, client);
+            break;
+
+        case CommandType::CLOSE:
+            if (client->_fd >= 0)
+            {
+                // Not registered if never attached, the error is meaningless
+                epoll_ctl(shard->epoll, EPOLL_CTL_DEL, client->_fd, nullptr);
+                ::close(client->_fd);
+                client->_fd = -1;
+                shard->clients.erase(client);
+
+                client->drop(&client->_outbound);
+                client->drop(&client->_writing);
+                client->_replaceableIdx.clear();
+            }
+            break;
+
+        case CommandType::RELEASE:
+            // Anything before it has been handled, nothing else will come
+            client->_released = true;
+            break;
+    }
+}
+
+void EpollTransport::acceptAll()
+{
+    while (true)
+    {
+        int fd = accept4(_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0)
+        {
+            Server::get()->accept(fd);
+            continue;
+        }
+
+        if (errno == EINTR)
+        {
+            continue;
+        }
+
+        // Edge-triggered, it will not be reported again until a new one arrives
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            LOG(LOG_CLIENT_LIFECYCLE, "Accept failed: %d", errno);
+        }
+
+        return;
+    }
+}
+
+void EpollTransport::readAll(Client* client)
+{
+    // Edge-triggered, read until there is nothing left
+    while (true)
+    {
+        uint8_t* buffer = client->_recv.data() + client->_recvEnd;
+        ssize_t size = ::read(client->_fd, buffer, client->_recv.size() - client->_recvEnd);
+
+        if (size > 0)
+        {
+            client->_recvEnd += size;
+            client->_lastActivity = std::chrono::high_resolution_clock::now();
+            if (!client->splitFrames())
+            {
+                return;
+            }
+            continue;
+        }
+
+        if (size == 0)
+        {
+            LOG(LOG_CLIENT_LIFECYCLE, "Closed: %" PRId64, time(NULL));
+            client->close();
+            return;
+        }
+
+        if (errno == EINTR)
+        {
+            continue;
+        }
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            client->close();
+        }
+
+        return;
+    }
+}
+
+void EpollTransport::writeAll(Shard* shard, Client* client)
+{
+    while (true)
+    {
+        if (client->_writing.empty())
+        {
+            if (client->_outbound.empty())
+            {
+                return;
+            }
+
+            std::swap(client->_writing, client->_outbound);
+            client->_replaceableIdx.clear();
+            client->_written = 0;
+        }
+
+        // Skip whatever previous partial writes got through
+        shard->iov.clear();
+        std::size_t skip = client->_written;
+        std::size_t pending = 0;
+        for (auto& packet : client->_writing)
+        {
+            std::size_t size = packet->written();
+            if (skip >= size)
+            {
+                skip -= size;
+                continue;
+            }
+
+            if (shard->iov.size() == IOV_MAX)
+            {
+                pending += size - skip;
+                skip = 0;
+                continue;
+            }
+
+            shard->iov.push_back({ packet->data() + skip, size - skip });  // NOLINT(whitespace/braces)
+            pending += size - skip;
+            skip = 0;
+        }
+
+        ssize_t size = ::writev(client->_fd, shard->iov.data(), static_cast<int>(shard->iov.size()));
+        if (size < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            // Resumed once writable again (EPOLLOUT)
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                client->close();
+            }
+
+            return;
+        }
+
+        LOG(LOG_PACKET_SEND, "\t%d bytes sent!", static_cast<int>(size));
+
+        client->_written += size;
+        if (static_cast<std::size_t>(size) == pending)
+        {
+            client->drop(&client->_writing);
+        }
+    }
+}
+
+void EpollTransport::sweep(Shard* shard)
+{
+    auto now = std::chrono::high_resolution_clock::now();
+    for (auto client : shard->clients)
+    {
+        if (now - client->_lastActivity > std::chrono::seconds(ClientTimeout))
+        {
+            LOG(LOG_CLIENT_LIFECYCLE, "Timeout: %" PRId64, time(NULL));
+            client->close();
+        }
+    }
+}
+
+#endif
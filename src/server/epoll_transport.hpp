@@ -0,0 +1,102 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#ifdef __linux__
+
+#include "server/transport.hpp"
+
+#include <inttypes.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include "defs/intrusive.hpp"
+#include <boost/intrusive_ptr.hpp>
+INCL_WARN
+
+
+// Events handled on each wake up, at most
+constexpr int MaxEpollEvents = 256;
+
+// Milliseconds between idle clients checks
+constexpr int EpollSweepInterval = 1000;
+
+// Edge-triggered epoll backend, linux only
+// Clients are split in shards by id, each with its own thread and epoll set.
+// Reads go straight into the client receive buffer, and everything queued to
+// a shard (ie. all flushes of a tick) is handled at once after a single
+// wake up. Nothing is allocated per operation.
+class EpollTransport : public Transport
+{
+private:
+    enum class CommandType
+    {
+        ATTACH,
+        SUBMIT,
+        CLOSE,
+        RELEASE
+    };
+
+    struct Command
+    {
+        CommandType type;
+        Client* client;
+        std::vector<boost::intrusive_ptr<Packet>> packets;
+    };
+
+    struct Shard
+    {
+        int epoll;
+        int wakeup;  // eventfd, written when commands become non-empty
+        std::thread thread;
+
+        std::mutex mutex;
+        std::vector<Command> commands;
+        bool stopped;  // Its thread is gone, commands are run as they are pushed
+
+        // Only touched from the shard thread
+        std::unordered_set<Client*> clients;
+        std::vector<iovec> iov;
+    };
+
+public:
+    explicit EpollTransport(uint8_t numThreads);
+    EpollTransport(const EpollTransport& transport) = delete;
+    virtual ~EpollTransport();
+
+    void start(int listener) override;
+    void stop() override;
+
+    void attach(Client* client) override;
+    void submit(Client* client, std::vector<boost::intrusive_ptr<Packet>>&& packets) override;
+    void close(Client* client) override;
+    void release(Client* client) override;
+
+private:
+    void push(Client* client, CommandType type, std::vector<boost::intrusive_ptr<Packet>>&& packets = {});  // NOLINT(whitespace/braces)
+    void run(Shard* shard);
+    void drain(Shard* shard, std::vector<Command>* commands);
+    void execute(Shard* shard, Command& command);
+
+    void acceptAll();
+    void readAll(Client* client);
+    void writeAll(Shard* shard, Client* client);
+    void sweep(Shard* shard);
+
+    Shard* shard(Client* client);
+
+private:
+    int _listener;
+    std::vector<std::unique_ptr<Shard>> _shards;
+    std::atomic<bool> _stop;
+};
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "server/input.hpp"
+#include "io/bit_stream.hpp"
+#include "io/packet.hpp"
+#include "io/packet_schema.hpp"
+#include "map/map_aware_entity.hpp"
+
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+using InputAckSchema = PacketSchema<uint32_t, uint64_t>;
+
+InputQueue::InputQueue() :
+    _lastQueued(0),
+    _applied(0),
+    _appliedTick(0),
+    _acked(0)
+{}
+
+bool InputQueue::push(Packet* packet, uint64_t tick)
+{
+    std::vector<Input> inputs;
+
+    try
+    {
+        packet->read(sizeof(uint16_t) * 2);
+
+        BitReader reader(packet);
+        uint64_t sequence = reader.readVarint();
+        uint64_t inputTick = reader.readVarint();
+        uint64_t count = reader.readVarint();
+        if (count > MaxQueuedInputs)
+        {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < count; ++i)
+        {
+            Input input;
+            input.sequence = static_cast<uint32_t>(sequence + i);
+            inputTick += reader.readVarint();
+            input.tick = inputTick;
+
+            uint64_t size = reader.readVarint();
+            if (size > MaxInputBytes)
+            {
+                return false;
+            }
+
+            input.size = static_cast<uint8_t>(size);
+            for (uint8_t j = 0; j < input.size; ++j)
+            {
+                input.data[j] = static_cast<uint8_t>(reader.read(8));
+            }
+
+            inputs.push_back(input);
+        }
+    }
+    catch (const ReadOutOfBounds& e)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& input : inputs)
+    {
+        // Resent, or too far ahead to be trusted
+        if (input.sequence <= _lastQueued || input.tick > tick + MaxInputLeadTicks)
+        {
+            continue;
+        }
+
+        if (_queued.size() >= MaxQueuedInputs)
+        {
+            break;
+        }
+
+        _queued.push_back(input);
+        _lastQueued = input.sequence;
+    }
+
+    return true;
+}
+
+void InputQueue::apply(MapAwareEntity* entity, uint64_t tick)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    while (!_queued.empty() && _queued.front().tick <= tick)
+    {
+        auto& input = _queued.front();
+
+        // Too late, the client corrects itself from the ack
+        if (input.tick + MaxInputLateTicks >= tick)
+        {
+            entity->onInput(input);
+        }
+
+        _applied = input.sequence;
+        _appliedTick = tick;
+        _queued.pop_front();
+    }
+}
+
+Packet* InputQueue::acknowledge()
+{
+    uint32_t applied = _applied;
+    if (applied == _acked)
+    {
+        return nullptr;
+    }
+
+    _acked = applied;
+    return InputAckSchema::create(InputAckOpcode, applied, _appliedTick.load());
+}
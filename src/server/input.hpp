@@ -0,0 +1,80 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+#include "defs/common.hpp"
+
+
+class MapAwareEntity;
+class Packet;
+
+// Batch of consecutive inputs, clients resend each one until acknowledged
+constexpr uint16_t InputBatchOpcode = 0x0B03;
+
+// Sequence of the last input applied, and the tick it was applied on
+constexpr uint16_t InputAckOpcode = 0x0B04;
+
+// Payload of a single input, its meaning is up to the derived project
+constexpr uint8_t MaxInputBytes = 16;
+
+// Inputs waiting for their tick, newer ones are dropped once full
+constexpr std::size_t MaxQueuedInputs = 64;
+
+// Ticks an input may arrive ahead of the simulation, or behind it
+constexpr uint8_t MaxInputLeadTicks = 16;
+constexpr uint8_t MaxInputLateTicks = 2;
+
+struct Input
+{
+    uint32_t sequence;
+    uint64_t tick;
+    uint8_t size;
+    std::array<uint8_t, MaxInputBytes> data;
+};
+
+// Per-client input pipeline
+// Inputs are stamped with the tick they are meant for and applied in order,
+// on that very tick, as part of the entity update. Duplicates (ie. resends),
+// inputs too far ahead and those arriving too late for their tick are
+// dropped. Acks carry the last sequence applied, so that clients only replay
+// what came after it.
+//
+// Batch layout, as a bit stream (sequences start at 1):
+//  varint first sequence, varint first tick, varint count
+//  for each input: varint ticks since the previous one, varint size, size x 8 bits
+class InputQueue
+{
+public:
+    InputQueue();
+    InputQueue(const InputQueue& queue) = delete;
+
+    // Thread-safe, queues new inputs of a batch read while on `tick`
+    // Returns false if the batch is malformed
+    bool push(Packet* packet, uint64_t tick);
+
+    // Applies every input due by `tick` through MapAwareEntity::onInput
+    // Must be called from the entity update
+    void apply(MapAwareEntity* entity, uint64_t tick);
+
+    // NOT thread-safe, ack of the last input applied if it changed since the
+    // last call, or nullptr
+    Packet* acknowledge();
+
+    inline uint32_t applied() { return _applied; }
+
+private:
+    std::mutex _mutex;
+    std::deque<Input> _queued;
+    uint32_t _lastQueued;
+
+    std::atomic<uint32_t> _applied;
+    std::atomic<uint64_t> _appliedTick;
+    uint32_t _acked;
+};
@@ -0,0 +1,214 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "server/replication.hpp"
+#include "io/bit_stream.hpp"
+#include "io/packet.hpp"
+#include "map/cell.hpp"
+#include "map/interest.hpp"
+#include "map/map.hpp"
+#include "map/map_aware_entity.hpp"
+#include "movement/motion_master.hpp"
+
+#include <math.h>
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+static_assert(MaxSnapshotBytes + MaxSnapshotRemovals * 10 < Packet::MaxSize, "Removals must fit next to the updates");
+
+Replication::Replication() :
+    _acked(0),
+    _lastSent(0),
+    _budget(DefaultSnapshotBudget)
+{
+    for (auto& sent : _sent)
+    {
+        sent.tick = 0;
+    }
+}
+
+void Replication::ack(uint64_t tick)
+{
+    if (tick > _lastSent)
+    {
+        return;
+    }
+
+    uint64_t acked = _acked;
+    while (tick > acked && !_acked.compare_exchange_weak(acked, tick))
+    {}
+}
+
+const Replication::Sent* Replication::baseline()
+{
+    uint64_t acked = _acked;
+    if (acked == 0)
+    {
+        return nullptr;
+    }
+
+    // Either too old or never sent
+    auto& sent = _sent[acked % SnapshotHistory];
+    return sent.tick == acked ? &sent : nullptr;
+}
+
+Packet* Replication::snapshot(MapAwareEntity* entity, uint64_t tick)
+{
+    Cell* cell = entity->cell();
+    if (!cell)
+    {
+        return nullptr;
+    }
+
+    // Everything its client sees, sorted to walk it along the baseline
+    std::vector<MapAwareEntity*> around;
+    for (auto seen : cell->map()->interest()->difference(cell, entity->interestRadius(), nullptr, 0))
+    {
+        for (auto& pair : seen->entities())
+        {
+            around.push_back(pair.second);
+        }
+    }
+
+    std::sort(around.begin(), around.end(), [](MapAwareEntity* a, MapAwareEntity* b)
+        {
+            return a->id() < b->id();
+        }
+    );  // NOLINT(whitespace/parens)
+
+    static const std::vector<std::pair<uint64_t, uint16_t>> none;
+    const Sent* base = baseline();
+    const auto& known = base ? base->entities : none;
+    uint64_t since = base ? base->tick : 0;
+
+    // Entity, fields to send and whether the client knows it
+    using Update = std::tuple<MapAwareEntity*, uint16_t, bool>;
+    std::vector<Update> updates;
+    std::vector<uint64_t> removed;
+    std::vector<std::pair<uint64_t, uint16_t>> upToDate;
+
+    auto it = known.begin();
+    for (auto other : around)
+    {
+        while (it != known.end() && it->first < other->id())
+        {
+            removed.push_back((it++)->first);
+        }
+
+        // New entities go in full, known ones with whatever was left pending
+        uint16_t mask = static_cast<uint16_t>((1 << other->fieldCount()) - 1);
+        bool isKnown = it != known.end() && it->first == other->id();
+        if (isKnown)
+        {
+            mask = other->changedSince(since) | it->second;
+            ++it;
+        }
+
+        if (mask)
+        {
+            updates.emplace_back(other, mask, isKnown);
+        }
+        else
+        {
+            upToDate.emplace_back(other->id(), 0);
+        }
+    }
+
+    for (; it != known.end(); ++it)
+    {
+        removed.push_back(it->first);
+    }
+
+    // Those left out stay known, thus they are removed later on
+    for (std::size_t i = MaxSnapshotRemovals; i < removed.size(); ++i)
+    {
+        upToDate.emplace_back(removed[i], 0);
+    }
+
+    removed.resize(std::min<std::size_t>(removed.size(), MaxSnapshotRemovals));
+
+    // Most relevant first, deferred updates keep what they were worth
+    std::unordered_map<uint64_t, float> priorities;
+    auto position = entity->motionMaster()->position2D();
+    for (auto& update : updates)
+    {
+        auto other = std::get<0>(update)->motionMaster();
+        float distance = glm::length(other->position2D() - position);
+        float worth = (1.0f + std::abs(other->speed()) / PrioritySpeedScale) * PriorityFalloff / (PriorityFalloff + distance);
+
+        auto deferred = _deferred.find(std::get<0>(update)->id());
+        priorities[std::get<0>(update)->id()] = worth + (deferred != _deferred.end() ? deferred->second : 0.0f);
+    }
+
+    std::stable_sort(updates.begin(), updates.end(), [&priorities](const Update& a, const Update& b)
+        {
+            return priorities[std::get<0>(a)->id()] > priorities[std::get<0>(b)->id()];
+        }
+    );  // NOLINT(whitespace/parens)
+
+    uint64_t elapsed = std::max<uint64_t>(tick - _lastSent, 1);
+    uint32_t allowance = static_cast<uint32_t>(std::min<uint64_t>(elapsed * _budget, MaxSnapshotBytes));
+
+    Packet* packet = Packet::create(SnapshotOpcode);
+    BitWriter writer(packet);
+    writer.writeVarint(tick);
+    writer.writeVarint(since);
+
+    writer.writeVarint(removed.size());
+    for (auto id : removed)
+    {
+        writer.writeVarint(id);
+    }
+
+    _deferred.clear();
+    uint16_t begin = packet->written();
+    for (auto& update : updates)
+    {
+        auto other = std::get<0>(update);
+        uint16_t mask = std::get<1>(update);
+
+        // Entities left out are not up to date, their changes go next time
+        if (packet->written() - begin >= allowance)
+        {
+            _deferred[other->id()] = priorities[other->id()];
+
+            // Still known by the client, it must hear about it if it leaves
+            if (std::get<2>(update))
+            {
+                upToDate.emplace_back(other->id(), mask);
+            }
+            continue;
+        }
+
+        writer.writeBool(true);
+        writer.writeVarint(other->id());
+        writer.writeVarint(mask);
+
+        for (uint8_t field = 0; field < other->fieldCount(); ++field)
+        {
+            if (mask & (1 << field))
+            {
+                other->writeField(field, writer);
+            }
+        }
+
+        upToDate.emplace_back(other->id(), 0);
+    }
+
+    writer.writeBool(false);
+    writer.flush();
+
+    // The baseline might be in the very same slot, thus it is replaced last
+    std::sort(upToDate.begin(), upToDate.end());
+    auto& sent = _sent[tick % SnapshotHistory];
+    sent.tick = tick;
+    sent.entities = std::move(upToDate);
+    _lastSent = tick;
+
+    return packet;
+}
@@ -0,0 +1,100 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "defs/common.hpp"
+
+
+class MapAwareEntity;
+class Packet;
+
+// Snapshot of the entities around a client, delta encoded
+constexpr uint16_t SnapshotOpcode = 0x0B01;
+
+// Sent back by clients with the tick of the last snapshot they applied
+constexpr uint16_t SnapshotAckOpcode = 0x0B02;
+
+// Sent snapshots remembered per client, older acks fall back to a full one
+constexpr std::size_t SnapshotHistory = 32;
+
+// Once a snapshot is this big, remaining updates wait for the next one
+constexpr uint16_t MaxSnapshotBytes = 8 * 1024;
+
+// Removed ids per snapshot, the rest are still known and wait for the next one
+// Varints take 10 bytes at most, thus they always fit next to the updates
+constexpr uint16_t MaxSnapshotRemovals = 512;
+
+// Snapshot bytes each client gets per tick elapsed since its last snapshot
+constexpr uint16_t DefaultSnapshotBudget = 512;
+
+// Distance, in world units, at which updates are worth half as much
+constexpr float PriorityFalloff = 80.0f;
+
+// Speed at which updates are worth twice as much as those of still entities
+constexpr float PrioritySpeedScale = 10.0f;
+
+// Per-client snapshot state
+// Each snapshot only carries what changed since the last one the client
+// acknowledged: new entities in full, known entities with their dirty fields
+// and the ids of those no longer around. Lost or late snapshots need no
+// resend, the next one is still relative to what the client does have.
+//
+// Snapshot layout, as a bit stream:
+//  varint tick, varint baseline tick (0 if none)
+//  varint removed count, removed count x varint id
+//  for each update: 1 bit set, varint id, varint field mask, fields in order
+//  1 bit unset
+//
+// Updates compete for a per-client byte budget. Each one is worth more the
+// closer and faster the entity is, and deferred ones keep adding up what they
+// are worth until they get in. Their changes are merged meanwhile, since the
+// next delta is still against what the client has. Deferred entities the
+// client already knows stay known, along with the fields still pending, thus
+// they are still removed if they leave before their turn.
+class Replication
+{
+private:
+    struct Sent
+    {
+        uint64_t tick;
+
+        // Sorted by id, along with the fields not up to date as of `tick`
+        std::vector<std::pair<uint64_t, uint16_t>> entities;
+    };
+
+public:
+    Replication();
+    Replication(const Replication& replication) = delete;
+
+    // Thread-safe, acks older than the current one or of snapshots not sent
+    // yet are ignored
+    void ack(uint64_t tick);
+    inline uint64_t acked() { return _acked; }
+
+    // NOT thread-safe, bytes per tick
+    inline uint16_t budget() { return _budget; }
+    inline void budget(uint16_t bytes) { _budget = bytes; }
+
+    // Builds the snapshot of the given tick for the entities around `entity`
+    // NOT thread-safe, must be called from the map thread
+    Packet* snapshot(MapAwareEntity* entity, uint64_t tick);
+
+private:
+    const Sent* baseline();
+
+private:
+    std::atomic<uint64_t> _acked;
+    std::atomic<uint64_t> _lastSent;
+    std::array<Sent, SnapshotHistory> _sent;
+
+    uint16_t _budget;
+    std::unordered_map<uint64_t /*id*/, float> _deferred;
+};
@@ -3,10 +3,14 @@
 #include "server/server.hpp"
 #include "defs/atomic_autoincrement.hpp"
 #include "server/client.hpp"
+#include "io/packet.hpp"
+#include "io/packet_schema.hpp"
 #include "debug/debug.hpp"
 #include "debug/reactive.hpp"
 #include "map/map.hpp"
 #include "map/map_aware_entity.hpp"
+#include "server/transport.hpp"
+#include "server/udp_transport.hpp"
 
 #include <list>
 
@@ -25,7 +29,13 @@ constexpr const TimeBase WORLD_HEART_BEAT = TimeBase(50);
 Server::Server(uint16_t port) :
     _service(),
     _acceptor(_service, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
-    _socket(_service)
+    _socket(_service),
+    _udp(nullptr),
+    _transport(nullptr),
+    _tick(0),
+    _snapshotInterval(0),
+    _stageReady(false),
+    _stopSender(false)
 {
     checkInstance();
     _map = new Map();
@@ -33,6 +43,11 @@ Server::Server(uint16_t port) :
 
 Server::~Server()
 {
+    // Too late for derived servers, but nothing else can be done by now
+    stop();
+
+    delete _transport;
+    delete _udp;
     delete _map;
 }
 
@@ -41,6 +56,41 @@ void Server::updateIO()
     _service.run();
 }
 
+void Server::startIO(uint8_t numThreads)
+{
+    // Keep threads alive even if there is no pending operation
+    _work.reset(new boost::asio::io_service::work(_service));
+
+    for (int i = 0; i < numThreads; ++i)
+    {
+        _ioThreads.emplace_back(std::thread([this] { _service.run(); }));
+    }
+}
+
+void Server::stopIO()
+{
+    _work.reset();
+    _service.stop();
+
+    for (auto&& thread : _ioThreads)
+    {
+        thread.join();
+    }
+
+    _ioThreads.clear();
+}
+
+void Server::stop()
+{
+    pipelined(false);
+    if (_transport)
+    {
+        _transport->stop();
+    }
+
+    stopIO();
+}
+
 void Server::runScheduledOperations()
 {
     std::list<Operation*> pending;
@@ -51,12 +101,24 @@ void Server::runScheduledOperations()
             {
                 case OperationType::ACCEPT:
                     this->handleAccept(op->client, op->error);
+
+                    // Token and port to send datagrams to
+                    if (_udp && !op->error)
+                    {
+                        op->client->send(PacketSchema<uint64_t, uint16_t>::create(UdpTokenOpcode, _udp->issue(op->client), _udp->port()));
+                    }
                     delete op;
                     break;
 
                 case OperationType::CLOSE:
-                    // Still in the map
-                    if (op->client->inMap())
+                    // No new datagram is handed to it, those already are in flight
+                    if (_udp)
+                    {
+                        _udp->revoke(op->client);
+                    }
+
+                    // Still in the map, or the transport is not done with it
+                    if (op->client->inMap() || !op->client->release())
                     {
                         pending.push_back(op);
                     }
@@ -84,19 +146,52 @@ void Server::update()
     _now = std::chrono::high_resolution_clock::now();
     auto diff = std::chrono::duration_cast<TimeBase>(_now - _lastUpdate);
     _lastUpdate = _now;
+    ++_tick;
     
     // First update map
     map()->update(diff.count());
-    
+
     // Run scheduled tasks, which might include packets
     Executor<8192>::executeJobs();
 
+    // Clients might be destroyed from here on, the last tick must be out
+    waitStage();
+
     // Last, server wide operations (ie. accept/close clients)
     runScheduledOperations();
 
+    // Freeze everything sent during this tick, before cleanup clears it
+    bool snapshot = _snapshotInterval && _tick % _snapshotInterval == 0;
+    iterateClients([this, snapshot](Client* client)
+        {
+            if (snapshot)
+            {
+                client->snapshot(_tick);
+            }
+
+            client->acknowledge();
+            client->cut();
+            _stageClients.push_back(client);
+        }
+    );  // NOLINT(whitespace/parens)
+
+    map()->collect();
+
     // Now cleanup map
     map()->cleanup(diff.count());
 
+    // And send it all, maybe while the next tick is simulated
+    if (pipelined())
+    {
+        std::lock_guard<std::mutex> lock(_stageMutex);
+        _stageReady = true;
+        _stageSignal.notify_all();
+    }
+    else
+    {
+        sendStage();
+    }
+
     // Debug info
     Reactive::get()->update(WORLD_HEART_BEAT, diff, _prevSleepTime);
 
@@ -114,8 +209,104 @@ void Server::update()
     LOG(LOG_SERVER_LOOP, "DIFF: %" PRId64 " - SLEEP: %" PRId64, diff.count(), _prevSleepTime.count());
 }
 
+void Server::pipelined(bool enable)
+{
+    if (enable == pipelined())
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        _stopSender = false;
+        _sender = std::thread([this] { sendLoop(); });
+        return;
+    }
+
+    // Let the last stage finish before stopping
+    waitStage();
+    {
+        std::lock_guard<std::mutex> lock(_stageMutex);
+        _stopSender = true;
+        _stageSignal.notify_all();
+    }
+
+    _sender.join();
+}
+
+void Server::sendLoop()
+{
+    std::unique_lock<std::mutex> lock(_stageMutex);
+
+    while (true)
+    {
+        _stageSignal.wait(lock, [this] { return _stageReady || _stopSender; });
+        if (!_stageReady)
+        {
+            return;
+        }
+
+        lock.unlock();
+        sendStage();
+        lock.lock();
+
+        _stageReady = false;
+        _stageSignal.notify_all();
+    }
+}
+
+void Server::sendStage()
+{
+    // Broadcasts go behind what each client was sent directly
+    map()->fanOut();
+
+    for (auto client : _stageClients)
+    {
+        client->flush();
+    }
+
+    _stageClients.clear();
+}
+
+void Server::waitStage()
+{
+    std::unique_lock<std::mutex> lock(_stageMutex);
+    _stageSignal.wait(lock, [this] { return !_stageReady; });
+}
+
+void Server::startUdp(uint16_t port)
+{
+    LOG_ASSERT(!_transport, "UDP sessions run on client strands, unavailable with native transports");
+
+    _udp = new UdpTransport(&_service, port);
+    _udp->start();
+}
+
+void Server::transport(Transport* transport)
+{
+    LOG_ASSERT(!_udp, "UDP sessions run on client strands, unavailable with native transports");
+
+    _transport = transport;
+}
+
+void Server::accept(int fd)
+{
+    Client* client = newClient(&_service, AtomicAutoIncrement<0>::get());
+    client->native(_transport, fd);
+
+    Reactive::get()->onClientCreated();
+    _operations.push(new Operation{ OperationType::ACCEPT, client, boost::system::error_code() });  // NOLINT (whitespace/braces)
+}
+
 void Server::startAccept()
 {
+    // The transport keeps accepting on its own
+    if (_transport)
+    {
+        _transport->start(_acceptor.native_handle());
+        return;
+    }
+
     Client* client = newClient(&_service, AtomicAutoIncrement<0>::get());
 
     _acceptor.async_accept(client->socket(), [this, client](const auto error)
@@ -134,6 +325,11 @@ void Server::handleAccept(Client* client, const boost::system::error_code& error
     Reactive::get()->onClientAccepted();
 }
 
+void Server::handleFrame(Client* client, Packet* packet)
+{
+    LOG(LOG_PACKET_RECV, "Unhandled frame %.4X", packet->peek<uint16_t>(0));
+}
+
 void Server::handleClose(Client* client)
 {
     Reactive::get()->onClientClosed();
@@ -12,8 +12,13 @@ INCL_NOWARN
 INCL_WARN
 
 #include <inttypes.h>
+#include <condition_variable>
 #include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 
 class Client;
@@ -21,6 +26,8 @@ class Map;
 class MapAwareEntity;
 class Packet;
 class Cell;
+class Transport;
+class UdpTransport;
 
 // TODO(gpascualg): Is 8192 too much?
 class Server : public Executor<8192>
@@ -36,7 +43,7 @@ private:
     {
         OperationType type;
         Client* client;
-        const boost::system::error_code& error;
+        boost::system::error_code error;
     };
 
 public:
@@ -54,16 +61,59 @@ public:
 
     static Server* get() { return _instance; }
 
+    // Runs IO on the calling thread, until stopped
     void updateIO();
+
+    // Runs IO on dedicated threads, each client is serialized by its strand
+    void startIO(uint8_t numThreads);
+    void stopIO();
+
+    // Stops the send thread, the transport and IO threads, all of which touch
+    // clients or call into derived servers (ie. handleRead)
+    // Derived servers must call it first thing in their destructor, before
+    // anything those calls use is gone. Safe to call more than once
+    void stop();
     void runScheduledOperations();
 
     inline Map* map() { return _map; }
     inline TimePoint now() { return _now; }
+    inline uint64_t tick() { return _tick; }
     void update();
 
+    // Pipelined mode sends tick N from a dedicated thread while tick N+1 is
+    // being simulated. Otherwise everything is sent before sleeping
+    // NOT thread-safe, must be called from the map thread
+    void pipelined(bool enable);
+    inline bool pipelined() { return _sender.joinable(); }
+
+    // Ticks between delta snapshots sent to each client, 0 disables them
+    inline uint8_t snapshotInterval() { return _snapshotInterval; }
+    inline void snapshotInterval(uint8_t ticks) { _snapshotInterval = ticks; }
+
+    // Optional UDP socket, clients get its token once accepted and keep TCP
+    // until their first valid datagram arrives
+    // Must be called before startAccept, not available with native transports
+    void startUdp(uint16_t port);
+    inline UdpTransport* udp() { return _udp; }
+
+    // Native transport replacing asio for client sockets, takes ownership
+    // Must be set before startAccept, there is no need for startIO then
+    void transport(Transport* transport);
+    inline Transport* transport() { return _transport; }
+
+    // Creates the client of a socket accepted by the native transport
+    // Called from the transport threads
+    void accept(int fd);
+
     void startAccept();
     virtual void handleAccept(Client* client, const boost::system::error_code& error);
+    // Called from any IO thread, but never concurrently for the same client
     virtual void handleRead(Client* client, const boost::system::error_code& error, size_t size) = 0;
+
+    // Same, for clients using Client::startReading, once per complete frame
+    // The packet is a view over the receive buffer, only valid during the call
+    // Snapshot acks and input batches are handled by the client itself, before getting here
+    virtual void handleFrame(Client* client, Packet* packet);
     virtual void handleClose(Client* client);
 
     virtual void onWorkError(AbstractWork* work);
@@ -77,11 +127,20 @@ public:
     virtual void destroyMapAwareEntity(MapAwareEntity* entity) = 0;
     virtual void iterateClients(std::function<void(Client* client)> callback) = 0;
 
+private:
+    void sendLoop();
+    void sendStage();
+    void waitStage();
+
 private:
     // Sockets io
     boost::asio::io_service _service;
     boost::asio::ip::tcp::acceptor _acceptor;
     boost::asio::ip::tcp::socket _socket;
+    std::unique_ptr<boost::asio::io_service::work> _work;
+    std::vector<std::thread> _ioThreads;
+    UdpTransport* _udp;
+    Transport* _transport;
 
     // Map
     Map* _map;
@@ -90,6 +149,18 @@ private:
     TimePoint _lastUpdate;
     TimePoint _now;
     TimeBase _prevSleepTime;
+    uint64_t _tick;
+
+    // Replication
+    uint8_t _snapshotInterval;
+
+    // Send stage, clients are those cut on the last tick
+    std::vector<Client*> _stageClients;
+    std::thread _sender;
+    std::mutex _stageMutex;
+    std::condition_variable _stageSignal;
+    bool _stageReady;
+    bool _stopSender;
 
     // Sync operations
     boost::lockfree::queue<Operation*, boost::lockfree::capacity<1024>> _operations;
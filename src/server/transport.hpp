@@ -0,0 +1,43 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <vector>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include "defs/intrusive.hpp"
+#include <boost/intrusive_ptr.hpp>
+INCL_WARN
+
+
+class Client;
+class Packet;
+
+// Native alternative to asio for streaming clients (see Client::startReading)
+// Backends take over the listening socket and hand each accepted connection
+// to Server::accept. All IO of a given client must be serialized, as its
+// strand does, and Server::handleFrame only called from the backend threads.
+class Transport
+{
+public:
+    virtual ~Transport() {}
+
+    // Takes over an already listening socket
+    virtual void start(int listener) = 0;
+    virtual void stop() = 0;
+
+    // Thread-safe, all of them are handled in the order they were called
+    // Starts receiving into the client buffer
+    virtual void attach(Client* client) = 0;
+
+    // Queues packets ready to be written (see Packet::finalize)
+    virtual void submit(Client* client, std::vector<boost::intrusive_ptr<Packet>>&& packets) = 0;
+
+    // Stops all IO of the client and closes its socket
+    virtual void close(Client* client) = 0;
+
+    // Done with the client, it is marked as released once nothing refers to it
+    virtual void release(Client* client) = 0;
+};
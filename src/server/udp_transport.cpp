@@ -0,0 +1,113 @@
+/* Copyright 2016 Guillem Pascual */
+
+#include "server/udp_transport.hpp"
+#include "debug/debug.hpp"
+#include "io/packet.hpp"
+#include "server/client.hpp"
+
+#include <string.h>
+#include <random>
+
+#include "defs/common.hpp"
+
+
+using udp = boost::asio::ip::udp;
+
+UdpTransport::UdpTransport(boost::asio::io_service* service, uint16_t port) :
+    _socket(*service, udp::endpoint(udp::v4(), port)),
+    _strand(*service),
+    _random(std::random_device()())
+{}
+
+UdpTransport::~UdpTransport()
+{
+    boost::system::error_code error;
+    _socket.close(error);
+}
+
+void UdpTransport::start()
+{
+    _strand.dispatch([this]()
+        {
+            receive();
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+uint16_t UdpTransport::port()
+{
+    return _socket.local_endpoint().port();
+}
+
+uint64_t UdpTransport::issue(Client* client)
+{
+    std::lock_guard<std::mutex> lock(_tokensMutex);
+
+    // 0 is never handed out
+    uint64_t token;
+    do
+    {
+        token = _random();
+    }
+    while (token == 0 || _tokens.find(token) != _tokens.end());
+
+    _tokens.emplace(token, client);
+    client->token(token);
+    return token;
+}
+
+void UdpTransport::revoke(Client* client)
+{
+    std::lock_guard<std::mutex> lock(_tokensMutex);
+    _tokens.erase(client->token());
+}
+
+void UdpTransport::send(const udp::endpoint& endpoint, boost::intrusive_ptr<Packet> datagram)
+{
+    _strand.post([this, endpoint, datagram]()
+        {
+            _socket.async_send_to(boost::asio::buffer(datagram->data(), datagram->written()), endpoint, _strand.wrap(
+                [datagram](const boost::system::error_code& error, size_t size)
+                {
+                    // Nothing to do, UDP losses are handled by the sessions
+                }
+            ));  // NOLINT(whitespace/parens)
+        }
+    );  // NOLINT(whitespace/parens)
+}
+
+void UdpTransport::receive()
+{
+    _socket.async_receive_from(boost::asio::buffer(_buffer), _from, _strand.wrap(
+        [this](const boost::system::error_code& error, size_t size)
+        {
+            if (error == boost::asio::error::operation_aborted)
+            {
+                return;
+            }
+
+            if (!error && size > sizeof(uint64_t))
+            {
+                uint64_t token;
+                memcpy(&token, _buffer.data(), sizeof(uint64_t));
+
+                // Handed to the client strand, the buffer is reused right away
+                // Still locked, the client can not be revoked and destroyed meanwhile
+                std::lock_guard<std::mutex> lock(_tokensMutex);
+                auto it = _tokens.find(token);
+                if (it != _tokens.end())
+                {
+                    boost::intrusive_ptr<Packet> datagram = Packet::create();
+                    memcpy(datagram->claim(size - sizeof(uint64_t)), _buffer.data() + sizeof(uint64_t), size - sizeof(uint64_t));
+                    it->second->receive(datagram, _from);
+                }
+                else
+                {
+                    LOG(LOG_PACKET_RECV, "Datagram with an unknown token");
+                }
+            }
+
+            receive();
+        }
+    ));  // NOLINT(whitespace/parens)
+}
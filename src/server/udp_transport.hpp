@@ -0,0 +1,59 @@
+/* Copyright 2016 Guillem Pascual */
+
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+#include "defs/common.hpp"
+
+INCL_NOWARN
+#include <boost/asio.hpp>
+#include "defs/intrusive.hpp"
+#include <boost/intrusive_ptr.hpp>
+INCL_WARN
+
+
+class Client;
+class Packet;
+
+// Single UDP socket shared by all clients, next to the TCP acceptor
+// Clients get a random token over TCP, and prefix every datagram with it.
+// Whatever endpoint the last valid datagram came from is where replies go,
+// thus NAT rebinds are followed transparently.
+class UdpTransport
+{
+public:
+    UdpTransport(boost::asio::io_service* service, uint16_t port);
+    UdpTransport(const UdpTransport& transport) = delete;
+    virtual ~UdpTransport();
+
+    // Starts receiving on the IO threads
+    void start();
+    uint16_t port();
+
+    // Thread-safe, tokens identify clients until revoked
+    // Datagrams are handed to clients under the same lock, thus once revoked
+    // none is, and those already handed are in flight (see Client::release)
+    uint64_t issue(Client* client);
+    void revoke(Client* client);
+
+    // Thread-safe, sends are serialized on the transport strand
+    void send(const boost::asio::ip::udp::endpoint& endpoint, boost::intrusive_ptr<Packet> datagram);
+
+private:
+    void receive();
+
+private:
+    boost::asio::ip::udp::socket _socket;
+    boost::asio::io_service::strand _strand;
+    boost::asio::ip::udp::endpoint _from;
+    std::array<uint8_t, 2048> _buffer;
+
+    std::mutex _tokensMutex;
+    std::unordered_map<uint64_t, Client*> _tokens;
+    std::mt19937_64 _random;
+};
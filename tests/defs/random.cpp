@@ -0,0 +1,49 @@
+#include <catch2/catch.hpp>
+
+#include <defs/random.hpp>
+
+#include <vector>
+
+
+static std::vector<uint64_t> draw(Random random, int count)
+{
+    std::vector<uint64_t> values;
+    for (int i = 0; i < count; ++i)
+    {
+        values.push_back(random());
+    }
+
+    return values;
+}
+
+SCENARIO("Entity streams are deterministic", "[random]") {
+    GIVEN("The global seed") {
+        uint64_t seed = Random::seed();
+
+        WHEN("the same entity draws at the same tick twice") {
+            THEN("it gets the same sequence") {
+                REQUIRE(draw(Random::forEntity(7, 100), 16) == draw(Random::forEntity(7, 100), 16));
+            }
+        }
+
+        WHEN("different entities draw at the same tick") {
+            THEN("they get different sequences") {
+                auto first = draw(Random::forEntity(7, 100), 16);
+                REQUIRE(first != draw(Random::forEntity(8, 100), 16));
+                REQUIRE(first != draw(Random::forEntity(7, 101), 16));
+            }
+        }
+
+        WHEN("the global seed changes") {
+            auto before = draw(Random::forEntity(7, 100), 16);
+            Random::seed(seed + 1);
+            auto after = draw(Random::forEntity(7, 100), 16);
+            Random::seed(seed);
+
+            THEN("the sequence changes too") {
+                REQUIRE(before != after);
+                REQUIRE(before == draw(Random::forEntity(7, 100), 16));
+            }
+        }
+    }
+}
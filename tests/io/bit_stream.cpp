@@ -0,0 +1,70 @@
+#include <catch2/catch.hpp>
+#include "mocks/server.hpp"
+
+#include <io/bit_stream.hpp>
+#include <io/packet.hpp>
+#include <map/offset.hpp>
+
+#include <math.h>
+
+
+SCENARIO("Values are bit-packed and quantized", "[io]") {
+    TestServer server(12345);
+
+    GIVEN("A packet written through a bit stream") {
+        Packet* packet = Packet::create(0x0001);
+        glm::vec2 position{ 1234.567f, -890.123f };  // NOLINT(whitespace/braces)
+
+        {
+            BitWriter writer(packet);
+            writer.write(5, 3);
+            writer.writeBool(true);
+            writer.writeVarint(300);
+            writer.writeSigned(-2);
+            writer.write(0xDEADBEEFCAFEull, 48);
+            writer.writeAngle(1.0f);
+            writer.writeQuantized(0.25f, 0.0f, 1.0f, 8);
+            writer.writeCellPosition(position);
+        }
+
+        *packet << uint16_t{ 0xABCD };  // NOLINT(whitespace/braces)
+        packet->read<uint16_t>();
+        packet->read<uint16_t>();
+
+        WHEN("it is read back") {
+            BitReader reader(packet);
+
+            THEN("values match within their precision") {
+                REQUIRE(reader.read(3) == 5);
+                REQUIRE(reader.readBool());
+                REQUIRE(reader.readVarint() == 300);
+                REQUIRE(reader.readSigned() == -2);
+                REQUIRE(reader.read(48) == 0xDEADBEEFCAFEull);
+                REQUIRE(std::abs(reader.readAngle() - 1.0f) < 0.01f);
+                REQUIRE(std::abs(reader.readQuantized(0.0f, 1.0f, 8) - 0.25f) < 0.005f);
+
+                auto decoded = reader.readCellPosition();
+                REQUIRE(glm::distance(decoded, position) < 0.01f);
+
+                // Bit stream ends on a byte boundary
+                REQUIRE(packet->read<uint16_t>() == 0xABCD);
+            }
+
+            THEN("it is smaller than raw fields") {
+                REQUIRE(packet->written() < 4 + 1 + 2 + 8 + 8 + 4 + 4 + 8 + 2);
+            }
+        }
+
+        WHEN("too much is read") {
+            BitReader reader(packet);
+            reader.read(64);
+            reader.read(64);
+
+            THEN("it throws") {
+                REQUIRE_THROWS_AS(reader.read(64), ReadOutOfBounds);
+            }
+        }
+
+        packet->destroy();
+    }
+}
@@ -0,0 +1,78 @@
+#include <catch2/catch.hpp>
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+
+
+SCENARIO("Packets grow through their size classes", "[io]") {
+    TestServer server(12345);
+
+    GIVEN("A packet written one byte at a time") {
+        Packet* packet = Packet::create(0x0001);
+        REQUIRE(packet->capacity() == PacketSizeClasses[0]);
+
+        WHEN("it crosses every class boundary") {
+            for (uint8_t sizeClass = 1; sizeClass < NumPacketSizeClasses; ++sizeClass)
+            {
+                while (packet->written() < PacketSizeClasses[sizeClass - 1])
+                {
+                    *packet << static_cast<uint8_t>(packet->written());
+                }
+
+                // Exactly full, still the previous class
+                REQUIRE(packet->capacity() == PacketSizeClasses[sizeClass - 1]);
+
+                *packet << static_cast<uint8_t>(packet->written());
+                REQUIRE(packet->capacity() == PacketSizeClasses[sizeClass]);
+            }
+
+            THEN("nothing written before is lost") {
+                REQUIRE(packet->peek<uint16_t>(0) == 0x0001);
+                for (uint16_t i = 4; i < packet->written(); ++i)
+                {
+                    REQUIRE(packet->data()[i] == static_cast<uint8_t>(i));
+                }
+            }
+        }
+
+        WHEN("a single write spans several classes") {
+            packet->claim(PacketSizeClasses[2] + 1);
+
+            THEN("it goes straight to the class that fits") {
+                REQUIRE(packet->capacity() == PacketSizeClasses[3]);
+            }
+        }
+
+        WHEN("it would go past the biggest class") {
+            uint16_t maxSize = Packet::MaxSize;
+            packet->claim(maxSize - packet->written());
+
+            THEN("the write is rejected") {
+                REQUIRE(packet->capacity() == maxSize);
+                REQUIRE_THROWS_AS(*packet << uint8_t{ 0 }, WriteOutOfBounds);  // NOLINT(whitespace/braces)
+                REQUIRE(packet->written() == maxSize);
+            }
+        }
+
+        packet->destroy();
+    }
+
+    GIVEN("A packet viewing external memory") {
+        uint8_t frame[] = { 0x01, 0x00, 0x02, 0x00, 0xAB, 0xCD };  // NOLINT(whitespace/braces)
+        Packet* packet = Packet::create();
+        packet->view(frame, sizeof(frame));
+
+        WHEN("it has to grow") {
+            packet->reserve(PacketSizeClasses[1]);
+            frame[4] = 0;
+
+            THEN("it owns a copy of what it viewed") {
+                REQUIRE(packet->capacity() == PacketSizeClasses[1]);
+                REQUIRE(packet->peek<uint8_t>(4) == 0xAB);
+                REQUIRE(packet->peek<uint8_t>(5) == 0xCD);
+            }
+        }
+
+        packet->destroy();
+    }
+}
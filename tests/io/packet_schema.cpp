@@ -0,0 +1,81 @@
+#include <catch2/catch.hpp>
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <io/packet_schema.hpp>
+
+#include <string>
+
+
+SCENARIO("Packets are serialized through schemas", "[io]") {
+    using Schema = PacketSchema<uint64_t, uint8_t, float, glm::vec2>;
+    TestServer server(12345);
+
+    GIVEN("A schema with mixed fields") {
+        THEN("its size is known at compile time") {
+            static_assert(Schema::Size == 8 + 1 + 4 + 8, "Unexpected schema size");
+            REQUIRE(Schema::Size == 21);
+        }
+
+        WHEN("a packet is written and read back") {
+            Packet* packet = Schema::create(0x0A04, 1234567890123ULL, 7, 0.5f, { 1.0f, -2.0f });  // NOLINT(whitespace/braces)
+            packet->read<uint16_t>();
+            packet->read<uint16_t>();
+
+            uint64_t id;
+            uint8_t speed;
+            float t;
+            glm::vec2 start;
+            Schema::read(packet, id, speed, t, start);
+
+            THEN("all fields match, with a single reservation") {
+                REQUIRE(packet->written() == 4 + Schema::Size);
+                REQUIRE(packet->capacity() == PacketSizeClasses[0]);
+                REQUIRE(id == 1234567890123ULL);
+                REQUIRE(speed == 7);
+                REQUIRE(t == 0.5f);
+                REQUIRE(start.x == 1.0f);
+                REQUIRE(start.y == -2.0f);
+            }
+
+            packet->destroy();
+        }
+
+        WHEN("a truncated packet is read") {
+            Packet* packet = Packet::create(0x0A04);
+            *packet << uint64_t{ 1 } << uint8_t{ 2 };  // NOLINT(whitespace/braces)
+            packet->read<uint16_t>();
+            packet->read<uint16_t>();
+
+            uint64_t id;
+            uint8_t speed;
+            float t;
+            glm::vec2 start;
+
+            THEN("nothing is consumed") {
+                REQUIRE_THROWS_AS(Schema::read(packet, id, speed, t, start), ReadOutOfBounds);
+                REQUIRE(packet->totalRead() == 4);
+            }
+
+            packet->destroy();
+        }
+    }
+
+    GIVEN("A string") {
+        std::string str(300, 'x');
+
+        WHEN("it is written") {
+            Packet* packet = Packet::create(0x0001);
+            *packet << str;
+            packet->read<uint16_t>();
+            packet->read<uint16_t>();
+
+            THEN("it is copied in bulk and read back") {
+                REQUIRE(packet->written() == 4 + 2 + 300);
+                REQUIRE(packet->read<std::string>() == str);
+            }
+
+            packet->destroy();
+        }
+    }
+}
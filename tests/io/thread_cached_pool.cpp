@@ -0,0 +1,98 @@
+#include <catch2/catch.hpp>
+
+#include <io/thread_cached_pool.hpp>
+
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+
+struct CrossThreadTag {};
+using TestPool = ThreadCachedPool<CrossThreadTag, 64>;
+
+SCENARIO("Thread caches hand chunks over to each other", "[io]") {
+    GIVEN("Chunks allocated on one thread") {
+        constexpr std::size_t Chunks = PoolCacheBatch * 3;
+
+        std::vector<void*> chunks;
+        std::thread([&chunks]()
+            {
+                for (std::size_t i = 0; i < Chunks; ++i)
+                {
+                    chunks.push_back(TestPool::malloc());
+                }
+            }
+        ).join();  // NOLINT(whitespace/parens)
+
+        std::unordered_set<void*> allocated(chunks.begin(), chunks.end());
+        REQUIRE(allocated.size() == Chunks);
+
+        WHEN("another thread frees them all and exits") {
+            std::thread([&chunks]()
+                {
+                    for (auto chunk : chunks)
+                    {
+                        TestPool::free(chunk);
+                    }
+                }
+            ).join();  // NOLINT(whitespace/parens)
+
+            THEN("a third thread gets those same chunks back, by batches") {
+                std::unordered_set<void*> reused;
+                std::thread([&reused]()
+                    {
+                        for (std::size_t i = 0; i < Chunks; ++i)
+                        {
+                            reused.insert(TestPool::malloc());
+                        }
+
+                        for (auto chunk : reused)
+                        {
+                            TestPool::free(chunk);
+                        }
+                    }
+                ).join();  // NOLINT(whitespace/parens)
+
+                REQUIRE(reused == allocated);
+            }
+        }
+    }
+
+    GIVEN("A thread freeing more than two batches") {
+        std::vector<void*> chunks;
+        for (std::size_t i = 0; i < PoolCacheBatch * 2; ++i)
+        {
+            chunks.push_back(TestPool::malloc());
+        }
+
+        std::unordered_set<void*> given(chunks.begin(), chunks.end());
+        for (auto chunk : chunks)
+        {
+            TestPool::free(chunk);
+        }
+
+        WHEN("another thread allocates while it is still alive") {
+            std::unordered_set<void*> taken;
+            std::thread([&taken]()
+                {
+                    for (std::size_t i = 0; i < PoolCacheBatch; ++i)
+                    {
+                        taken.insert(TestPool::malloc());
+                    }
+
+                    for (auto chunk : taken)
+                    {
+                        TestPool::free(chunk);
+                    }
+                }
+            ).join();  // NOLINT(whitespace/parens)
+
+            THEN("it gets the batch given back, not a new one") {
+                for (auto chunk : taken)
+                {
+                    REQUIRE(given.count(chunk) == 1);
+                }
+            }
+        }
+    }
+}
@@ -258,4 +258,46 @@ SCENARIO("Map cells can be created and eliminated", "[map]") {
             }
         }
     }
+
+    GIVEN("A map with one entity next to a cell edge") {
+        TestServer server(12345);
+        Map& map = *server.map();
+        map.cellHysteresis(5.0f);
+
+        Entity e1(0); e1.asDefault()->forceUpdater();
+        e1.motionMaster()->teleport({ 75, 0, 0 });
+
+        map.addTo(&e1, nullptr);
+        map.runScheduledOperations();
+
+        Cell* original = e1.cell();
+        REQUIRE(original != nullptr);
+
+        WHEN("it moves past the edge but within the hysteresis margin") {
+            e1.motionMaster()->teleport({ 82, 0, 0 });
+            map.onMove(&e1);
+            map.runScheduledOperations();
+
+            THEN("it keeps its cell") {
+                REQUIRE(e1.cell() == original);
+            }
+
+            THEN("it knows how much it can still move") {
+                REQUIRE(e1.motionMaster()->cellSlack() > 0);
+                REQUIRE(e1.motionMaster()->cellSlack() < 5.0f);
+            }
+        }
+
+        WHEN("it moves past the hysteresis margin") {
+            e1.motionMaster()->teleport({ 90, 0, 0 });
+            map.onMove(&e1);
+            map.runScheduledOperations();
+
+            THEN("it changes cell") {
+                REQUIRE(e1.cell() != original);
+                REQUIRE(e1.cell()->offset().q() == 1);
+                REQUIRE(e1.cell()->offset().r() == 0);
+            }
+        }
+    }
 }
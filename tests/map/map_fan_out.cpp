@@ -0,0 +1,213 @@
+#include <catch2/catch.hpp>
+#include "mocks/connection.hpp"
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <server/client.hpp>
+
+#include <string.h>
+#include <list>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+constexpr uint16_t FanOutPayload = 16;
+
+static void broadcast(Cell* cell, uint16_t first, uint16_t count)
+{
+    for (uint16_t opcode = first; opcode < first + count; ++opcode)
+    {
+        Packet* packet = Packet::create(opcode, FanOutPayload);
+        packet->claim(FanOutPayload);
+        cell->broadcast(packet);
+    }
+}
+
+// Movement update of an entity, replaceable by newer ones
+static void movement(Cell* cell, uint64_t id, uint8_t version)
+{
+    Packet* packet = Packet::create(0x0A04);
+    *packet << id << version;
+    cell->broadcast(packet);
+}
+
+// Entity id and version of the next `count` movement frames the peer gets
+static std::vector<std::pair<uint64_t, uint8_t>> movements(Connection& connection, std::size_t count)
+{
+    std::vector<std::pair<uint64_t, uint8_t>> result;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        uint16_t header[2];
+        boost::asio::read(connection.peer, boost::asio::buffer(header));
+
+        std::vector<uint8_t> payload(header[1]);
+        boost::asio::read(connection.peer, boost::asio::buffer(payload));
+
+        uint64_t id;
+        memcpy(&id, payload.data(), sizeof(uint64_t));
+        result.emplace_back(id, payload[sizeof(uint64_t)]);
+    }
+
+    return result;
+}
+
+SCENARIO("Broadcasts reach every subscriber once and in order", "[map]") {
+    GIVEN("Two cells, one seen by three clients and the other by one of them") {
+        constexpr uint16_t Broadcasts = 32;
+        constexpr uint32_t FrameSize = FanOutPayload + sizeof(uint16_t) * 2;
+
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        Entity a(1);
+        Entity b(2);
+        map.addTo(0, 0, a.asDefault(), nullptr);
+        map.addTo(8, 0, b.asDefault(), nullptr);
+        map.runScheduledOperations();
+
+        boost::asio::io_service service;
+        std::list<Connection> connections;
+        for (uint64_t id = 10; id < 13; ++id)
+        {
+            connections.emplace_back(service, id);
+            a.cell()->subscribe(connections.back().client);
+        }
+
+        Connection& both = connections.front();
+        b.cell()->subscribe(both.client);
+
+        broadcast(a.cell(), 0x0100, Broadcasts);
+        broadcast(b.cell(), 0x0200, Broadcasts);
+
+        // Broadcasts become outgoing once the cell is updated
+        a.cell()->update(0);
+        b.cell()->update(0);
+        map.collect();
+        map.fanOut();
+
+        THEN("each client is delivered what it sees, exactly once") {
+            REQUIRE(both.client->outboundBytes() == 2 * Broadcasts * FrameSize);
+            for (auto& connection : connections)
+            {
+                if (&connection != &both)
+                {
+                    REQUIRE(connection.client->outboundBytes() == Broadcasts * FrameSize);
+                }
+            }
+        }
+
+        THEN("each cell broadcasts arrive in the order they were made") {
+            for (auto& connection : connections)
+            {
+                connection.client->flush();
+            }
+
+            std::thread io([&service]() { service.run(); });
+            std::vector<std::vector<uint16_t>> received;
+            for (auto& connection : connections)
+            {
+                received.push_back(connection.receive(&connection == &both ? 2 * Broadcasts : Broadcasts));
+            }
+            io.join();
+            service.reset();
+
+            for (auto& opcodes : received)
+            {
+                uint16_t next[] = { 0x0100, 0x0200 };  // NOLINT(whitespace/braces)
+                for (auto opcode : opcodes)
+                {
+                    uint16_t& expected = next[(opcode >> 8) - 1];
+                    REQUIRE(opcode == expected);
+                    ++expected;
+                }
+            }
+        }
+
+        for (auto& connection : connections)
+        {
+            a.cell()->unsubscribe(connection.client);
+            b.cell()->unsubscribe(connection.client);
+            connection.client->close();
+        }
+
+        service.poll();
+        server.runScheduledOperations();
+    }
+}
+
+SCENARIO("Replaceable broadcasts are budgeted per client", "[map]") {
+    GIVEN("A client in the map seeing a close cell and a far one") {
+        constexpr uint32_t MovementSize = sizeof(uint16_t) * 2 + sizeof(uint64_t) + sizeof(uint8_t);
+
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        boost::asio::io_service service;
+        Connection connection(service, 10);
+        Client* client = connection.client;
+        client->deliveryBudget(4 * MovementSize);
+
+        Entity far(2);
+        map.addTo(0, 0, client->entity(), nullptr);
+        map.addTo(8, 0, far.asDefault(), nullptr);
+        map.runScheduledOperations();
+
+        Cell* closeCell = client->entity()->cell();
+        Cell* farCell = far.cell();
+        farCell->subscribe(client);
+
+        // The far cell is collected first, its updates are older too
+        for (uint64_t id = 100; id < 104; ++id)
+        {
+            movement(farCell, id, 1);
+        }
+        movement(farCell, 100, 2);
+
+        for (uint64_t id = 1; id < 5; ++id)
+        {
+            movement(closeCell, id, 1);
+        }
+
+        closeCell->update(0);
+        farCell->update(0);
+        client->cut();
+        map.collect();
+        map.fanOut();
+
+        THEN("the closest cell fills the budget and the rest waits") {
+            REQUIRE(client->outboundBytes() == 4 * MovementSize);
+            REQUIRE(client->deferred() == 4);
+        }
+
+        WHEN("the next tick is sent") {
+            client->flush();
+            client->cut();
+            client->flush();
+
+            std::thread io([&service]() { service.run(); });
+            auto received = movements(connection, 8);
+            io.join();
+            service.reset();
+
+            THEN("deferred updates catch up, only in their latest version") {
+                REQUIRE(client->deferred() == 0);
+
+                std::vector<std::pair<uint64_t, uint8_t>> expected = {
+                    { 1, 1 }, { 2, 1 }, { 3, 1 }, { 4, 1 },
+                    { 100, 2 }, { 101, 1 }, { 102, 1 }, { 103, 1 }
+                };  // NOLINT(whitespace/braces)
+                REQUIRE(received == expected);
+            }
+        }
+
+        farCell->unsubscribe(client);
+        client->close();
+        service.poll();
+        map.runScheduledOperations();
+        server.runScheduledOperations();
+    }
+}
@@ -0,0 +1,132 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <server/client.hpp>
+
+
+// Counts how many times it is serialized into spawn lists
+class SpawningEntity : public Entity
+{
+public:
+    using Entity::Entity;
+
+    bool writeSpawn(Packet* packet) override
+    {
+        ++spawns;
+        *packet << uint8_t{ 1 };  // NOLINT(whitespace/braces)
+        return true;
+    }
+
+    int spawns = 0;
+};
+
+SCENARIO("Spawn lists are shared until the cell changes", "[map]") {
+    GIVEN("A cell with two entities and two clients requesting it") {
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        SpawningEntity a(1);
+        SpawningEntity b(2);
+        map.addTo(0, 0, a.asDefault(), nullptr);
+        map.addTo(0, 0, b.asDefault(), nullptr);
+        map.runScheduledOperations();
+        Cell* cell = a.cell();
+
+        boost::asio::io_service service;
+        Client first(&service, 10);
+        Client second(&service, 11);
+
+        // Requests are served once the cell settles
+        auto tick = [&server, cell](std::vector<Client*> requesters)
+        {
+            server.update();
+            for (auto client : requesters)
+            {
+                cell->request(client->entity(), RequestType::SPAWN);
+            }
+
+            cell->update(0);
+            cell->settle();
+            cell->cleanup(0);
+        };
+
+        tick({ &first, &second });  // NOLINT(whitespace/braces)
+
+        THEN("both requests share a single serialization") {
+            REQUIRE(a.spawns == 1);
+            REQUIRE(b.spawns == 1);
+        }
+
+        WHEN("nothing changes") {
+            tick({ &first });  // NOLINT(whitespace/braces)
+
+            THEN("later requests reuse it") {
+                REQUIRE(a.spawns == 1);
+            }
+        }
+
+        WHEN("an entity changes") {
+            server.update();
+            a.dirty(PositionField);
+            tick({ &first });  // NOLINT(whitespace/braces)
+
+            THEN("only it is serialized again") {
+                REQUIRE(a.spawns == 2);
+                REQUIRE(b.spawns == 1);
+            }
+        }
+
+        WHEN("an entity keeps moving") {
+            for (int i = 0; i < 4; ++i)
+            {
+                server.update();
+                a.dirty(PositionField);
+                tick({ &first, &second });  // NOLINT(whitespace/braces)
+            }
+
+            THEN("the still one is reused every time") {
+                REQUIRE(a.spawns == 5);
+                REQUIRE(b.spawns == 1);
+            }
+        }
+
+        WHEN("an entity changes later in the same tick it was serialized") {
+            a.dirty(PositionField);
+            tick({ &first });  // NOLINT(whitespace/braces)
+
+            THEN("it is serialized again") {
+                REQUIRE(a.spawns == 2);
+            }
+        }
+
+        WHEN("an entity joins the cell") {
+            SpawningEntity c(3);
+            map.addTo(0, 0, c.asDefault(), nullptr);
+            map.runScheduledOperations();
+            tick({ &first });  // NOLINT(whitespace/braces)
+
+            THEN("only the newcomer is serialized") {
+                REQUIRE(a.spawns == 1);
+                REQUIRE(c.spawns == 1);
+            }
+
+            map.removeFrom(cell, &c, nullptr);
+            map.runScheduledOperations();
+        }
+
+        WHEN("an entity leaves the cell") {
+            map.removeFrom(cell, &b, nullptr);
+            map.runScheduledOperations();
+            tick({ &first });  // NOLINT(whitespace/braces)
+
+            THEN("lists are rebuilt without it, from what was serialized") {
+                REQUIRE(a.spawns == 1);
+                REQUIRE(b.spawns == 1);
+            }
+        }
+    }
+}
@@ -0,0 +1,234 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <server/client.hpp>
+
+#include <string.h>
+#include <list>
+#include <thread>
+#include <vector>
+
+
+// Payload sizes, taken in the order entities are first serialized
+static std::list<uint16_t> sizes;
+
+class ListEntity : public Entity
+{
+public:
+    using Entity::Entity;
+
+    bool writeSpawn(Packet* packet) override
+    {
+        return write(packet, 0xAA);
+    }
+
+    bool writeDespawn(Packet* packet) override
+    {
+        return write(packet, 0xDD);
+    }
+
+private:
+    bool write(Packet* packet, uint8_t fill)
+    {
+        // Kept if written again, ie. in a new list
+        if (!_size)
+        {
+            _size = sizes.empty() ? 4 : sizes.front();
+            if (!sizes.empty())
+            {
+                sizes.pop_front();
+            }
+        }
+
+        memset(packet->claim(_size), fill, _size);
+        return true;
+    }
+
+    uint16_t _size = 0;
+};
+
+struct Entry
+{
+    uint64_t id;
+    uint16_t length;
+    uint8_t fill;
+};
+
+struct List
+{
+    uint16_t opcode;
+    std::vector<Entry> entries;
+};
+
+// Reads `count` list frames from the peer, checking their layout as it goes
+static std::vector<List> receive(boost::asio::ip::tcp::socket* peer, std::size_t count)
+{
+    std::vector<List> lists;
+    while (lists.size() < count)
+    {
+        uint16_t header[2];
+        boost::asio::read(*peer, boost::asio::buffer(header));
+
+        std::vector<uint8_t> data(header[1]);
+        boost::asio::read(*peer, boost::asio::buffer(data));
+
+        List list { header[0], {} };  // NOLINT(whitespace/braces)
+        uint16_t entries;
+        memcpy(&entries, data.data(), sizeof(uint16_t));
+
+        std::size_t offset = sizeof(uint16_t);
+        for (uint16_t i = 0; i < entries; ++i)
+        {
+            Entry entry;
+            memcpy(&entry.id, data.data() + offset, sizeof(uint64_t));
+            memcpy(&entry.length, data.data() + offset + sizeof(uint64_t), sizeof(uint16_t));
+            offset += sizeof(uint64_t) + sizeof(uint16_t);
+
+            entry.fill = entry.length ? data[offset] : 0;
+            offset += entry.length;
+            list.entries.push_back(entry);
+        }
+
+        REQUIRE(offset == data.size());
+        lists.push_back(list);
+    }
+
+    return lists;
+}
+
+SCENARIO("Spawns and despawns are sent as lists", "[map]") {
+    GIVEN("A cell with a few entities and a connected client") {
+        using tcp = boost::asio::ip::tcp;
+
+        TestServer server(12345);
+        Map& map = *server.map();
+        sizes.clear();
+
+        std::list<ListEntity> entities;
+        for (uint64_t id = 1; id <= 3; ++id)
+        {
+            entities.emplace_back(id);
+            map.addTo(0, 0, entities.back().asDefault(), nullptr);
+        }
+        map.runScheduledOperations();
+        Cell* cell = entities.front().cell();
+
+        boost::asio::io_service service;
+        tcp::socket peer(service);
+        Client* client = new Client(&service, 10);
+        {
+            tcp::acceptor acceptor(service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+            peer.connect(acceptor.local_endpoint());
+            acceptor.accept(client->socket());
+        }
+
+        // Serves the request and reads what the client got
+        auto request = [&](RequestType type, std::size_t count)
+        {
+            server.update();
+            cell->request(client->entity(), type);
+            cell->update(0);
+            cell->settle();
+            cell->cleanup(0);
+
+            client->cut();
+            client->flush();
+
+            std::thread io([&service]() { service.run(); });
+            auto lists = receive(&peer, count);
+            io.join();
+            service.reset();
+            return lists;
+        };
+
+        WHEN("spawns are requested") {
+            auto lists = request(RequestType::SPAWN, 1);
+
+            THEN("all of them go in a single list") {
+                REQUIRE(lists[0].opcode == SpawnListOpcode);
+                REQUIRE(lists[0].entries.size() == 3);
+                for (auto& entry : lists[0].entries)
+                {
+                    REQUIRE(entry.id >= 1);
+                    REQUIRE(entry.id <= 3);
+                    REQUIRE(entry.length == 4);
+                    REQUIRE(entry.fill == 0xAA);
+                }
+            }
+        }
+
+        WHEN("spawns are requested again after an entity moved") {
+            request(RequestType::SPAWN, 1);
+            server.update();
+            entities.front().dirty(PositionField);
+            auto lists = request(RequestType::SPAWN, 1);
+
+            THEN("unchanged entries are copied back in place") {
+                REQUIRE(lists[0].entries.size() == 3);
+                for (auto& entry : lists[0].entries)
+                {
+                    REQUIRE(entry.length == 4);
+                    REQUIRE(entry.fill == 0xAA);
+                }
+            }
+        }
+
+        WHEN("despawns are requested") {
+            auto lists = request(RequestType::DESPAWN, 1);
+
+            THEN("all of them go in a single list") {
+                REQUIRE(lists[0].opcode == DespawnListOpcode);
+                REQUIRE(lists[0].entries.size() == 3);
+                REQUIRE(lists[0].entries[0].fill == 0xDD);
+            }
+        }
+
+        WHEN("lists grow past their split size") {
+            sizes = { MaxEntityListBytes / 2, MaxEntityListBytes / 2, 4 };  // NOLINT(whitespace/braces)
+            auto lists = request(RequestType::SPAWN, 2);
+
+            THEN("the rest go in a new list") {
+                REQUIRE(lists[0].entries.size() == 2);
+                REQUIRE(lists[1].entries.size() == 1);
+            }
+        }
+
+        WHEN("an entry does not fit in what is left of a list") {
+            sizes = { MaxEntityListBytes - 64, MaxEntityListBytes + 64, 4 };  // NOLINT(whitespace/braces)
+            auto lists = request(RequestType::SPAWN, 2);
+
+            THEN("it goes first in a new list") {
+                REQUIRE(lists[0].entries.size() == 1);
+                REQUIRE(lists[0].entries[0].length == MaxEntityListBytes - 64);
+                REQUIRE(lists[1].entries.size() == 1);
+                REQUIRE(lists[1].entries[0].length == MaxEntityListBytes + 64);
+
+                // Lists are full from now on, the last one is a list on its own
+                auto last = receive(&peer, 1);
+                REQUIRE(last[0].entries.size() == 1);
+                REQUIRE(last[0].entries[0].length == 4);
+            }
+        }
+
+        WHEN("an entry would not fit even alone") {
+            uint16_t maxSize = Packet::MaxSize;
+            sizes = { 4, maxSize, 4 };  // NOLINT(whitespace/braces)
+            auto lists = request(RequestType::SPAWN, 2);
+
+            THEN("it is left out, the rest still go") {
+                REQUIRE(lists[0].entries.size() == 1);
+                REQUIRE(lists[1].entries.size() == 1);
+                REQUIRE(lists[0].entries[0].length == 4);
+                REQUIRE(lists[1].entries[0].length == 4);
+            }
+        }
+
+        client->close();
+        service.poll();
+        server.runScheduledOperations();
+    }
+}
@@ -0,0 +1,194 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <map/cell.hpp>
+#include <map/interest.hpp>
+#include <map/map.hpp>
+
+#include <vector>
+
+
+static int subscriptions(Map& map, Client* client, int radius)
+{
+    int count = 0;
+    for (int q = -radius; q <= radius; ++q)
+    {
+        for (int r = -radius; r <= radius; ++r)
+        {
+            Cell* cell = map.get(q, r);
+            if (cell && cell->subscribers().count(client))
+            {
+                ++count;
+            }
+        }
+    }
+
+    return count;
+}
+
+// Subscribed to the cell, or waiting for it to be created
+static bool sees(Map& map, Client* client, const Offset& offset)
+{
+    Cell* cell = map.get(offset);
+    return cell ? cell->subscribers().count(client) == 1 : map.interest()->pending(offset) == 1;
+}
+
+SCENARIO("Clients subscribe to the cells they see", "[map]") {
+    GIVEN("A client in the middle of the map") {
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        boost::asio::io_service service;
+        Client client(&service, 1);
+        auto entity = static_cast<Entity*>(client.entity())->asDefault();
+
+        map.addTo(0, 0, entity, nullptr);
+        map.runScheduledOperations();
+
+        THEN("it sees its cell and all siblings") {
+            REQUIRE(subscriptions(map, &client, 3) == 7);
+            REQUIRE(map.get(0, 0)->subscribers().count(&client) == 1);
+            for (auto cell : map.getSiblings(map.get(0, 0)))
+            {
+                REQUIRE(cell->subscribers().count(&client) == 1);
+            }
+        }
+
+        WHEN("it moves to the next cell") {
+            Cell* from = map.get(0, 0);
+            Cell* to = map.get(1, 0);
+
+            map.removeFrom(from, entity, to);
+            map.addTo(to, entity, from);
+            map.runScheduledOperations();
+
+            THEN("only the cells around the new one are seen") {
+                REQUIRE(subscriptions(map, &client, 3) == 7);
+                REQUIRE(to->subscribers().count(&client) == 1);
+                REQUIRE(map.get(2, 0)->subscribers().count(&client) == 1);
+                REQUIRE(map.get(-1, 0)->subscribers().count(&client) == 0);
+            }
+        }
+
+        WHEN("it jumps several cells away") {
+            Cell* from = map.get(0, 0);
+            Cell* to = map.getOrCreate(3, 0);
+
+            map.removeFrom(from, entity, to);
+            map.addTo(to, entity, from);
+            map.runScheduledOperations();
+
+            THEN("it sees the new cell and its siblings only") {
+                REQUIRE(subscriptions(map, &client, 5) == 7);
+                REQUIRE(to->subscribers().count(&client) == 1);
+                REQUIRE(from->subscribers().count(&client) == 0);
+            }
+        }
+
+        WHEN("its view radius grows and it moves") {
+            entity->viewRadius(2);
+
+            Cell* from = map.get(0, 0);
+            Cell* to = map.get(1, 0);
+
+            map.removeFrom(from, entity, to);
+            map.addTo(to, entity, from);
+            map.runScheduledOperations();
+
+            THEN("it sees the whole disk around the new cell") {
+                for (auto& direction : map.interest()->disk())
+                {
+                    Offset offset(1 + direction.q, direction.r);
+                    REQUIRE(sees(map, &client, offset) == (offset.distance(Offset(1, 0)) <= 2));
+                }
+
+                REQUIRE(map.get(-1, 0)->subscribers().count(&client) == 1);
+                REQUIRE(map.get(-1, -1) == nullptr);
+            }
+
+            THEN("cells further than the siblings are not created") {
+                REQUIRE(map.get(3, 0) == nullptr);
+                REQUIRE(map.interest()->pending(Offset(3, 0)) == 1);
+            }
+
+            AND_WHEN("one of them is created later") {
+                Cell* far = map.getOrCreate(3, 0);
+
+                THEN("it is subscribed to right away") {
+                    REQUIRE(far->subscribers().count(&client) == 1);
+                    REQUIRE(map.interest()->pending(Offset(3, 0)) == 0);
+                }
+            }
+
+            AND_WHEN("it leaves the map") {
+                map.removeFrom(to, entity, nullptr);
+                map.runScheduledOperations();
+
+                THEN("nothing is seen anymore") {
+                    REQUIRE(subscriptions(map, &client, 5) == 0);
+                    REQUIRE(map.interest()->pending(Offset(3, 0)) == 0);
+                }
+            }
+        }
+
+        WHEN("it leaves the map") {
+            map.removeFrom(map.get(0, 0), entity, nullptr);
+            map.runScheduledOperations();
+
+            THEN("nothing is seen anymore") {
+                REQUIRE(subscriptions(map, &client, 3) == 0);
+            }
+        }
+
+        WHEN("its view radius is set wider than the widest one") {
+            entity->viewRadius(MaxViewRadius + 10);
+
+            THEN("it is clamped") {
+                REQUIRE(entity->viewRadius() == MaxViewRadius);
+                REQUIRE(entity->interestRadius() == DefaultViewRadius);
+            }
+        }
+    }
+}
+
+SCENARIO("Entering and leaving cells are disk differences", "[map]") {
+    GIVEN("A map with an updating entity") {
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        Entity e(0); e.forceUpdater();
+        map.addTo(0, 0, e.asDefault(), nullptr);
+        map.runScheduledOperations();
+
+        WHEN("moving to a neighbour") {
+            auto cells = map.getCellsExcluding(map.getOrCreate(1, 0), map.get(0, 0));
+
+            THEN("three cells are entered") {
+                REQUIRE(cells.size() == 3);
+                for (auto cell : cells)
+                {
+                    REQUIRE(cell->offset().distance(Offset(0, 0)) == 2);
+                }
+            }
+        }
+
+        WHEN("jumping further than the view radius") {
+            auto cells = map.getCellsExcluding(map.getOrCreate(5, -2), map.get(0, 0));
+
+            THEN("the whole disk is entered") {
+                REQUIRE(cells.size() == 7);
+            }
+        }
+
+        WHEN("disks of different radius are compared") {
+            std::vector<Offset> missing;
+            auto cells = map.interest()->difference(map.get(0, 0), 3, map.get(0, 0), 1, &missing);
+
+            THEN("only the outer rings remain, none of them created") {
+                REQUIRE(cells.size() + missing.size() == InterestManager::diskSize(3) - InterestManager::diskSize(1));
+                REQUIRE(cells.size() == 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <server/client.hpp>
+
+#include <vector>
+
+
+// Client connected to a peer socket through loopback
+struct Connection
+{
+    Connection(boost::asio::io_service& service, uint64_t id) :
+        client(new Client(&service, id)),
+        peer(service)
+    {
+        using tcp = boost::asio::ip::tcp;
+
+        tcp::acceptor acceptor(service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        peer.connect(acceptor.local_endpoint());
+        acceptor.accept(client->socket());
+    }
+
+    // Opcodes of the next `count` frames the peer gets, blocks until then
+    std::vector<uint16_t> receive(std::size_t count)
+    {
+        std::vector<uint16_t> opcodes;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            uint16_t header[2];
+            boost::asio::read(peer, boost::asio::buffer(header));
+
+            std::vector<uint8_t> payload(header[1]);
+            boost::asio::read(peer, boost::asio::buffer(payload));
+            opcodes.push_back(header[0]);
+        }
+
+        return opcodes;
+    }
+
+    Client* client;
+    boost::asio::ip::tcp::socket peer;
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "mocks/entity.hpp"
+
+#include <server/input.hpp>
+
+#include <inttypes.h>
+#include <vector>
+
+// Records the sequence of every input applied to it
+class InputEntity : public Entity
+{
+public:
+    using Entity::Entity;
+
+    void onInput(const Input& input) override
+    {
+        applied.push_back(input.sequence);
+    }
+
+    std::vector<uint32_t> applied;
+};
@@ -11,6 +11,11 @@ class TestServer : public Server
 public:
     using Server::Server;
 
+    ~TestServer()
+    {
+        stop();
+    }
+
     void handleAccept(Client* client, const boost::system::error_code& error) override
     {
 
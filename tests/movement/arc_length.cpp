@@ -0,0 +1,119 @@
+#include <catch2/catch.hpp>
+
+#include <movement/arc_length.hpp>
+#include <movement/movement_generator.hpp>
+
+#include <memory>
+#include <vector>
+
+INCL_NOWARN
+#include <glm/glm.hpp>
+INCL_WARN
+
+
+SCENARIO("Beziers are traversed at constant speed", "[movement]") {
+    GIVEN("A curved bezier with uneven control points") {
+        glm::vec2 a{ 0, 0 };
+        glm::vec2 b{ 0, 100 };
+        glm::vec2 c{ 20, 100 };
+        glm::vec2 d{ 100, 100 };
+        UniformBezier bezier(a, b, c, d);
+
+        THEN("its length lies between the chord and the control polygon") {
+            REQUIRE(bezier.length() > glm::distance(a, d));
+            REQUIRE(bezier.length() < glm::distance(a, b) + glm::distance(b, c) + glm::distance(c, d));
+        }
+
+        WHEN("it is walked in equal steps") {
+            constexpr int steps = ArcLengthTable::Samples;
+            float expected = bezier.length() / steps;
+            glm::vec2 previous = bezier.next(0);
+
+            THEN("every step covers roughly the same distance") {
+                for (int i = 1; i <= steps; ++i)
+                {
+                    glm::vec2 point = bezier.next(i / static_cast<float>(steps));
+                    REQUIRE(glm::distance(point, previous) == Approx(expected).epsilon(0.05));
+                    previous = point;
+                }
+
+                REQUIRE(glm::distance(previous, d) < 0.001f);
+            }
+        }
+    }
+
+    GIVEN("Two translated copies of the same curve") {
+        ArcLengthCache::clear();
+        auto first = ArcLengthCache::get({ 0, 0 }, { 0, 50 }, { 50, 50 }, { 50, 0 });  // NOLINT(whitespace/braces)
+        auto second = ArcLengthCache::get({ 80, 80 }, { 80, 130 }, { 130, 130 }, { 130, 80 });  // NOLINT(whitespace/braces)
+
+        THEN("they share the same table") {
+            REQUIRE(first == second);
+            REQUIRE(ArcLengthCache::size() == 1);
+        }
+
+        WHEN("a curve with another shape is requested") {
+            auto other = ArcLengthCache::get({ 80, 80 }, { 80, 150 }, { 130, 130 }, { 130, 80 });  // NOLINT(whitespace/braces)
+
+            THEN("it gets its own table") {
+                REQUIRE(other != first);
+                REQUIRE(other->length() > first->length());
+            }
+        }
+
+        ArcLengthCache::clear();
+    }
+
+    GIVEN("Several curves sharing a table") {
+        ArcLengthCache::clear();
+        std::vector<std::unique_ptr<UniformBezier>> beziers;
+        std::vector<UniformBezier*> curves;
+        for (int i = 0; i < 4; ++i)
+        {
+            glm::vec2 o{ i * 30.0f, i * 10.0f };  // NOLINT(whitespace/braces)
+            glm::vec2 b = o + glm::vec2{ 0, 50 };  // NOLINT(whitespace/braces)
+            glm::vec2 c = o + glm::vec2{ 50, 50 };  // NOLINT(whitespace/braces)
+            glm::vec2 d = o + glm::vec2{ 50, 0 };  // NOLINT(whitespace/braces)
+            beziers.emplace_back(new UniformBezier(o, b, c, d, ArcLengthCache::get(o, b, c, d)));
+            curves.push_back(beziers.back().get());
+        }
+
+        WHEN("they are evaluated in a single batch") {
+            float t[] = { 0.0f, 0.3f, 0.7f, 1.0f };  // NOLINT(whitespace/braces)
+            glm::vec2 out[4];
+            UniformBezier::evaluate(curves.data(), t, out, curves.size());
+
+            THEN("each point matches walking its curve alone") {
+                REQUIRE(ArcLengthCache::size() == 1);
+                for (std::size_t i = 0; i < curves.size(); ++i)
+                {
+                    glm::vec2 expected = curves[i]->next(t[i]);
+                    REQUIRE(out[i].x == Approx(expected.x));
+                    REQUIRE(out[i].y == Approx(expected.y));
+                }
+            }
+        }
+
+        ArcLengthCache::clear();
+    }
+
+    GIVEN("More curves than the cache holds") {
+        ArcLengthCache::clear();
+        auto first = ArcLengthCache::get({ 0, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 });  // NOLINT(whitespace/braces)
+
+        for (std::size_t i = 1; i <= MaxArcLengthTables; ++i)
+        {
+            ArcLengthCache::get({ 0, 0 }, { 0, 1.0f + i }, { 1, 1 }, { 1, 0 });  // NOLINT(whitespace/braces)
+        }
+
+        THEN("it never grows past its bound") {
+            REQUIRE(ArcLengthCache::size() <= MaxArcLengthTables);
+        }
+
+        THEN("tables still in use stay valid") {
+            REQUIRE(first->length() > 0);
+        }
+
+        ArcLengthCache::clear();
+    }
+}
@@ -0,0 +1,154 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <map/map-cluster/cluster.hpp>
+#include <map/quadtree.hpp>
+#include <movement/motion_batch.hpp>
+#include <movement/motion_master.hpp>
+#include <physics/bounding_box.hpp>
+#include <server/client.hpp>
+
+#include <algorithm>
+#include <list>
+
+INCL_NOWARN
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/rotate_vector.hpp>
+INCL_WARN
+
+
+// Remembers where it was when serialized into a spawn list
+class SpawnPositionEntity : public Entity
+{
+public:
+    using Entity::Entity;
+
+    bool writeSpawn(Packet* packet) override
+    {
+        spawnedAt = motionMaster()->position().x;
+        *packet << uint8_t{ 1 };  // NOLINT(whitespace/braces)
+        return true;
+    }
+
+    float spawnedAt = -1;
+};
+
+SCENARIO("Free motion is integrated in batches", "[movement]") {
+    GIVEN("A map with six entities moving along the same axis") {
+        TestServer server(12345);
+        Map& map = *server.map();
+        map.cellHysteresis(0);
+
+        std::list<Entity> entities;
+        for (int i = 0; i < 6; ++i)
+        {
+            entities.emplace_back(i);
+            auto& e = entities.back();
+            e.asDefault();
+            e.motionMaster()->teleport({ 15.0f * i, 0, 0 });
+            e.motionMaster()->forward(glm::vec3{ 1, 0, 0 });
+            e.motionMaster()->speed(1000);
+            e.motionMaster()->move();
+            map.addTo(&e, nullptr);
+        }
+
+        map.runScheduledOperations();
+
+        WHEN("they are integrated through a batch") {
+            auto batch = MotionBatch::local();
+            batch->begin();
+            for (auto& e : entities)
+            {
+                e.motionMaster()->update(10);
+            }
+
+            REQUIRE(batch->size() == 6);
+            batch->end(10);
+
+            THEN("all entities have advanced") {
+                int i = 0;
+                for (auto& e : entities)
+                {
+                    REQUIRE(e.motionMaster()->position().x == Approx(15.0f * i + 10.0f));
+                    REQUIRE(e.motionMaster()->position().z == Approx(0.0f));
+                    ++i;
+                }
+            }
+
+            THEN("only the entity that left its cell is reported") {
+                REQUIRE(batch->crossed().size() == 1);
+                REQUIRE(batch->crossed()[0] == entities.back().motionMaster());
+            }
+
+            THEN("no batch is collecting anymore") {
+                REQUIRE(MotionBatch::current() == nullptr);
+            }
+        }
+
+        WHEN("they are rotating too") {
+            for (auto& e : entities)
+            {
+                e.motionMaster()->forward(90.0f);
+            }
+
+            auto batch = MotionBatch::local();
+            batch->begin();
+            for (auto& e : entities)
+            {
+                e.motionMaster()->update(10);
+            }
+            batch->end(10);
+
+            THEN("forward vectors match the scalar rotation") {
+                auto expected = glm::normalize(glm::rotateY(glm::vec3{ 1, 0, 0 }, 0.9f));
+                for (auto& e : entities)
+                {
+                    REQUIRE(e.motionMaster()->forward().x == Approx(expected.x));
+                    REQUIRE(e.motionMaster()->forward().z == Approx(expected.z));
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Batched positions are final before cells settle", "[movement]") {
+    GIVEN("A moving entity and a spawn request for its cell") {
+        TestServer server(12345);
+        Map& map = *server.map();
+        map.cellHysteresis(0);
+
+        SpawnPositionEntity entity(1);
+        entity.asDefault();
+        entity.forceUpdater();
+        entity.motionMaster()->teleport({ 0, 0, 0 });  // NOLINT(whitespace/braces)
+        entity.motionMaster()->forward(glm::vec3{ 1, 0, 0 });  // NOLINT(whitespace/braces)
+        entity.motionMaster()->speed(1000);
+        entity.motionMaster()->move();
+        map.addTo(&entity, nullptr);
+        map.runScheduledOperations();
+        map.cluster()->runScheduledOperations(0);
+
+        boost::asio::io_service service;
+        Client client(&service, 10);
+
+        entity.cell()->request(client.entity(), RequestType::SPAWN);
+
+        WHEN("the cluster is updated") {
+            map.cluster()->update(10);
+
+            THEN("the spawn carries the position integrated this tick") {
+                REQUIRE(entity.spawnedAt == Approx(10.0f));
+            }
+
+            THEN("the quadtree finds it there") {
+                std::list<MapAwareEntity*> found;
+                entity.cell()->quadtree()->retrieve(found, entity.boundingBox()->asRect());
+                REQUIRE(std::find(found.begin(), found.end(), &entity) != found.end());
+            }
+        }
+    }
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <movement/motion_master.hpp>
+#include <pathfinding/flow_field.hpp>
+#include <pathfinding/flow_field_movement.hpp>
+#include <pathfinding/pathfinder.hpp>
+
+#include <list>
+
+
+SCENARIO("Crowds follow a shared flow field", "[pathfinding]") {
+    GIVEN("A target behind a wall and a few followers") {
+        TestServer server(12345);
+        Map& map = *server.map();
+        Pathfinder& pathfinder = *map.pathfinder();
+
+        for (int32_t r = -3; r <= 3; ++r)
+        {
+            pathfinder.obstacle(Offset(2, r));
+        }
+
+        Entity target(100);
+        target.asDefault();
+        auto goal = Offset(4, 0).center();
+        target.motionMaster()->teleport({ goal.x, 0, goal.y });
+        map.addTo(&target, nullptr);
+
+        std::list<Entity> followers;
+        for (int i = 0; i < 8; ++i)
+        {
+            followers.emplace_back(i);
+            auto& e = followers.back();
+            e.asDefault();
+            e.motionMaster()->teleport({ static_cast<float>(i), 0, 0 });
+            e.motionMaster()->speed(100);
+            map.addTo(&e, nullptr);
+        }
+
+        map.runScheduledOperations();
+
+        WHEN("all of them chase the target") {
+            for (auto& e : followers)
+            {
+                e.motionMaster()->generator(new FlowFieldMovement(pathfinder.flowField(&target)));
+            }
+
+            for (int tick = 0; tick < 400; ++tick)
+            {
+                pathfinder.tick();
+                for (auto& e : followers)
+                {
+                    e.motionMaster()->update(50);
+                }
+                map.runScheduledOperations();
+            }
+
+            THEN("they share a single field, built once") {
+                auto field = pathfinder.flowField(&target);
+                REQUIRE(field->builds() == 1);
+            }
+
+            THEN("they reach it without crossing the wall") {
+                for (auto& e : followers)
+                {
+                    REQUIRE(glm::distance(e.motionMaster()->position2D(), goal) < DefaultFollowDistance + 5.0f);
+                    REQUIRE(e.cell()->offset().hash() == Offset(4, 0).hash());
+                }
+            }
+        }
+
+        WHEN("the target changes cell") {
+            auto field = pathfinder.flowField(&target);
+            glm::vec2 waypoint;
+            REQUIRE(field->next({ 0, 0 }, &waypoint));  // NOLINT(whitespace/braces)
+
+            auto next = Offset(5, 0).center();
+            target.motionMaster()->teleport({ next.x, 0, next.y });
+            map.onMove(&target);
+            map.runScheduledOperations();
+
+            THEN("followers keep the current field until the next tick") {
+                REQUIRE(field->next({ 0, 0 }, &waypoint));  // NOLINT(whitespace/braces)
+                REQUIRE(field->builds() == 1);
+            }
+
+            THEN("the field is rebuilt only once") {
+                pathfinder.tick();
+                REQUIRE(field->next({ 0, 0 }, &waypoint));  // NOLINT(whitespace/braces)
+                REQUIRE(field->next({ 10, 0 }, &waypoint));  // NOLINT(whitespace/braces)
+                REQUIRE(field->builds() == 2);
+            }
+        }
+
+        WHEN("the target leaves the map") {
+            auto field = pathfinder.flowField(&target);
+            glm::vec2 waypoint;
+            REQUIRE(field->next({ 0, 0 }, &waypoint));  // NOLINT(whitespace/braces)
+
+            map.removeFrom(target.cell(), &target, nullptr);
+            map.runScheduledOperations();
+            pathfinder.tick();
+
+            THEN("it is no longer followed") {
+                REQUIRE(field->target() == nullptr);
+                REQUIRE_FALSE(field->next({ 0, 0 }, &waypoint));  // NOLINT(whitespace/braces)
+            }
+        }
+    }
+}
@@ -0,0 +1,159 @@
+#include <catch2/catch.hpp>
+
+#include <io/packet.hpp>
+#include <map/offset.hpp>
+#include <pathfinding/path_movement.hpp>
+#include <pathfinding/pathfinder.hpp>
+
+#include <chrono>
+#include <future>
+#include <vector>
+
+
+static bool isReady(std::future<PathPtr>& future)
+{
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+SCENARIO("Paths are found over the hex grid", "[pathfinding]") {
+    GIVEN("A pathfinder without threads and a wall between two cells") {
+        Pathfinder pathfinder(0);
+        for (int32_t r = -3; r <= 3; ++r)
+        {
+            pathfinder.obstacle(Offset(2, r));
+        }
+
+        WHEN("a path is requested") {
+            auto future = pathfinder.request(Offset(0, 0), Offset(4, 0));
+
+            THEN("it is not solved until the next tick") {
+                REQUIRE(!isReady(future));
+
+                pathfinder.tick();
+                REQUIRE(isReady(future));
+
+                auto path = future.get();
+                REQUIRE(path->size() > 5);
+                REQUIRE(offsetOf(path->front().x, path->front().y).hash() == Offset(0, 0).hash());
+                REQUIRE(offsetOf(path->back().x, path->back().y).hash() == Offset(4, 0).hash());
+
+                for (auto& point : *path)
+                {
+                    REQUIRE(!pathfinder.isObstacle(offsetOf(point.x, point.y)));
+                }
+            }
+        }
+
+        WHEN("the same path is requested twice") {
+            auto first = pathfinder.request(Offset(0, 0), Offset(4, 0));
+            pathfinder.tick();
+
+            auto second = pathfinder.request(Offset(0, 0), Offset(4, 0));
+
+            THEN("the second one comes from the cache") {
+                REQUIRE(isReady(second));
+                REQUIRE(first.get() == second.get());
+            }
+        }
+
+        WHEN("the grid changes") {
+            auto first = pathfinder.request(Offset(0, 0), Offset(4, 0));
+            pathfinder.tick();
+            REQUIRE(pathfinder.cacheSize() == 1);
+
+            pathfinder.obstacle(Offset(2, 0), false);
+
+            THEN("cached paths are discarded") {
+                REQUIRE(pathfinder.cacheSize() == 0);
+
+                auto second = pathfinder.request(Offset(0, 0), Offset(4, 0));
+                pathfinder.tick();
+                REQUIRE(second.get()->size() == 5);
+            }
+        }
+
+        WHEN("more paths are requested than can be queued") {
+            std::vector<std::future<PathPtr>> futures;
+            for (int32_t q = 0; q <= static_cast<int32_t>(MaxQueuedPaths); ++q)
+            {
+                futures.push_back(pathfinder.request(Offset(0, 0), Offset(q, 4)));
+            }
+
+            THEN("the last one is reported unreachable right away") {
+                REQUIRE(!isReady(futures.front()));
+                REQUIRE(isReady(futures.back()));
+                REQUIRE(futures.back().get()->empty());
+            }
+        }
+
+        WHEN("the goal is an obstacle") {
+            auto future = pathfinder.request(Offset(0, 0), Offset(2, 0));
+            pathfinder.tick();
+
+            THEN("the path is empty") {
+                REQUIRE(future.get()->empty());
+            }
+        }
+
+        WHEN("a movement is created before its path is ready") {
+            PathMovement movement(pathfinder.request(Offset(-2, 0), Offset(2, 0)));
+
+            THEN("it has no packet to send yet") {
+                REQUIRE(!movement.ready());
+                REQUIRE(movement.packet() == nullptr);
+            }
+        }
+
+        WHEN("the search gives up before reaching the goal") {
+            const Offset goal(40, 0);
+            for (auto& direction : directions)
+            {
+                pathfinder.obstacle(Offset(goal.q() + direction.q, goal.r() + direction.r));
+            }
+
+            pathfinder.budget(MaxPathExpansions * 2);
+            auto first = pathfinder.request(Offset(0, 0), goal);
+            pathfinder.tick();
+            REQUIRE(isReady(first));
+            REQUIRE(first.get()->empty());
+
+            THEN("it is not cached, later requests search again") {
+                REQUIRE(pathfinder.cacheSize() == 0);
+                auto second = pathfinder.request(Offset(0, 0), goal);
+                REQUIRE(!isReady(second));
+            }
+        }
+
+        WHEN("the budget is too small for a single tick") {
+            pathfinder.budget(4);
+            auto future = pathfinder.request(Offset(0, 0), Offset(4, 0));
+
+            THEN("the search spans several ticks") {
+                pathfinder.tick();
+                REQUIRE(!isReady(future));
+
+                for (int i = 0; i < 100 && !isReady(future); ++i)
+                {
+                    pathfinder.tick();
+                }
+
+                REQUIRE(isReady(future));
+                REQUIRE(future.get()->size() > 5);
+            }
+        }
+    }
+
+    GIVEN("A pathfinder with a dedicated thread") {
+        Pathfinder pathfinder(1);
+
+        WHEN("a path is requested and the budget refilled") {
+            auto future = pathfinder.request(Offset(0, 0), Offset(0, 6));
+            pathfinder.tick();
+
+            THEN("it is solved asynchronously") {
+                REQUIRE(future.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+                REQUIRE(future.get()->size() == 7);
+            }
+        }
+    }
+}
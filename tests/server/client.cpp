@@ -0,0 +1,311 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <server/client.hpp>
+
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+// Counts destroyed clients, instead of waiting for them to crash
+class LifetimeServer : public TestServer
+{
+public:
+    using TestServer::TestServer;
+
+    void handleClose(Client* client) override
+    {
+        ++closed;
+        TestServer::handleClose(client);
+    }
+
+    void destroyClient(Client* client) override
+    {
+        ++destroyed;
+        delete client;
+    }
+
+    std::atomic<int> closed { 0 };  // NOLINT(whitespace/braces)
+    int destroyed = 0;
+};
+
+static Packet* payload(uint16_t opcode, uint16_t size)
+{
+    Packet* packet = Packet::create(opcode);
+    for (uint16_t i = 0; i < size; ++i)
+    {
+        *packet << static_cast<uint8_t>(i);
+    }
+
+    return packet;
+}
+
+// Movement update of an entity, replaced by newer ones over the soft limit
+static Packet* movement(uint64_t id, uint8_t version)
+{
+    Packet* packet = Packet::create(0x0A04);
+    *packet << id;
+    for (uint16_t i = 0; i < 1024; ++i)
+    {
+        *packet << version;
+    }
+
+    return packet;
+}
+
+// Connects the client socket to a peer, through loopback
+static void connect(boost::asio::io_service& service, Client* client, boost::asio::ip::tcp::socket* peer)
+{
+    using tcp = boost::asio::ip::tcp;
+
+    tcp::acceptor acceptor(service, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    peer->connect(acceptor.local_endpoint());
+    acceptor.accept(client->socket());
+}
+
+// Reads movement frames (id and version) until the one of `last` arrives
+static std::vector<std::pair<uint64_t, uint8_t>> receive(boost::asio::ip::tcp::socket* peer, uint64_t last)
+{
+    std::vector<std::pair<uint64_t, uint8_t>> result;
+    while (true)
+    {
+        uint16_t header[2];
+        boost::asio::read(*peer, boost::asio::buffer(header));
+
+        std::vector<uint8_t> data(header[1]);
+        boost::asio::read(*peer, boost::asio::buffer(data));
+        if (header[0] != 0x0A04)
+        {
+            continue;
+        }
+
+        uint64_t id;
+        memcpy(&id, data.data(), sizeof(uint64_t));
+        result.emplace_back(id, data[sizeof(uint64_t)]);
+
+        if (id == last)
+        {
+            return result;
+        }
+    }
+}
+
+SCENARIO("Clients outlive whatever refers to them", "[client]") {
+    GIVEN("A closed client with a flush still on its strand") {
+        LifetimeServer server(12345);
+        boost::asio::io_service service;
+
+        Client* client = new Client(&service, 1);
+        client->send(payload(0x0001, 8));
+        client->cut();
+        client->flush();
+        client->close();
+
+        WHEN("the close is scheduled before the strand runs") {
+            server.runScheduledOperations();
+
+            THEN("the client is kept alive") {
+                REQUIRE(server.destroyed == 0);
+            }
+        }
+
+        WHEN("the strand drains") {
+            service.poll();
+            server.runScheduledOperations();
+
+            THEN("the client is destroyed, with nothing left queued") {
+                REQUIRE(server.destroyed == 1);
+            }
+        }
+
+        // Whatever is left must not refer to a destroyed client
+        service.poll();
+        server.runScheduledOperations();
+        REQUIRE(server.destroyed == 1);
+    }
+
+    GIVEN("A closed client with a datagram still on its strand") {
+        LifetimeServer server(12345);
+        boost::asio::io_service service;
+
+        // Handed over after the close, but before its token is revoked
+        Client* client = new Client(&service, 1);
+        client->close();
+        service.poll();
+        service.reset();
+        client->receive(payload(0x0001, 8), boost::asio::ip::udp::endpoint());
+
+        WHEN("the close is scheduled before the strand runs") {
+            server.runScheduledOperations();
+
+            THEN("the client is kept alive") {
+                REQUIRE(server.destroyed == 0);
+            }
+        }
+
+        WHEN("the strand drains") {
+            service.poll();
+            server.runScheduledOperations();
+
+            THEN("the client is destroyed") {
+                REQUIRE(server.destroyed == 1);
+            }
+        }
+
+        service.poll();
+        server.runScheduledOperations();
+        REQUIRE(server.destroyed == 1);
+    }
+}
+
+SCENARIO("Packets are finalized before being shared", "[client]") {
+    GIVEN("A packet with a payload") {
+        TestServer server(12345);
+        boost::intrusive_ptr<Packet> packet = payload(0x0001, 8);
+
+        WHEN("it is sent") {
+            boost::asio::io_service service;
+            Client client(&service, 1);
+            client.send(packet);
+
+            THEN("its length is already set, before any flush") {
+                REQUIRE(packet->peek<uint16_t>(2) == 8);
+            }
+        }
+
+        WHEN("it is broadcast") {
+            boost::asio::io_service service;
+            Client client(&service, 1);
+
+            Entity entity(2);
+            entity.asDefault();
+            server.map()->addTo(&entity, nullptr);
+            server.map()->runScheduledOperations();
+
+            Cell* cell = entity.cell();
+            cell->subscribe(&client);
+            cell->broadcast(packet);
+            cell->unsubscribe(&client);
+
+            THEN("its length is already set, before the fan-out") {
+                REQUIRE(packet->peek<uint16_t>(2) == 8);
+            }
+
+            server.map()->removeFrom(cell, &entity, nullptr);
+            server.map()->runScheduledOperations();
+        }
+    }
+}
+
+SCENARIO("Outbound queues are bounded", "[client]") {
+    GIVEN("A connected client") {
+        TestServer server(12345);
+        boost::asio::io_service service;
+        boost::asio::ip::tcp::socket peer(service);
+
+        Client* client = new Client(&service, 1);
+        connect(service, client, &peer);
+
+        WHEN("it falls behind the soft limit") {
+            constexpr uint8_t Versions = 2 * OutboundSoftLimit / 1024;
+
+            for (uint8_t version = 0; version < Versions; ++version)
+            {
+                client->send(movement(7, version));
+            }
+            client->send(movement(8, 0));
+
+            client->cut();
+            client->flush();
+
+            // The write might not fit the socket buffers at once
+            std::thread io([&service]() { service.run(); });
+            auto received = receive(&peer, 8);
+            io.join();
+            service.reset();
+
+            THEN("stale updates are replaced, the latest one is kept") {
+                REQUIRE(received.size() < Versions);
+                REQUIRE(received.size() > 2);
+
+                auto latest = received[received.size() - 2];
+                REQUIRE(latest == std::make_pair(uint64_t{ 7 }, uint8_t{ Versions - 1 }));  // NOLINT(whitespace/braces)
+                REQUIRE(client->status() != Client::Status::CLOSED);
+            }
+
+            THEN("versions are never reordered") {
+                for (std::size_t i = 1; i + 1 < received.size(); ++i)
+                {
+                    REQUIRE(received[i - 1].second < received[i].second);
+                }
+            }
+        }
+
+        WHEN("it falls behind the hard limit") {
+            for (uint16_t i = 0; i <= OutboundHardLimit / 1024; ++i)
+            {
+                client->send(movement(i, 0));
+            }
+
+            service.poll();
+
+            THEN("it is closed") {
+                REQUIRE(client->status() == Client::Status::CLOSED);
+            }
+        }
+
+        client->close();
+        service.poll();
+        server.runScheduledOperations();
+    }
+}
+
+SCENARIO("Clients are closed once, from wherever it happens", "[client]") {
+    GIVEN("Clients closed concurrently from IO threads and the main thread") {
+        constexpr int Clients = 64;
+
+        LifetimeServer server(12345);
+        boost::asio::io_service service;
+        std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(service));
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+        {
+            threads.emplace_back([&service]() { service.run(); });
+        }
+
+        for (int i = 0; i < Clients; ++i)
+        {
+            Client* client = new Client(&service, i);
+            client->startReading();
+
+            // As a read error or timeout would, from any IO thread
+            for (int j = 0; j < 4; ++j)
+            {
+                service.post([client]() { client->close(); });
+            }
+            client->close();
+        }
+
+        work.reset();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        server.runScheduledOperations();
+
+        THEN("each of them is closed and destroyed exactly once") {
+            REQUIRE(server.closed == Clients);
+            REQUIRE(server.destroyed == Clients);
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include <catch2/catch.hpp>
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <server/datagram.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+
+static std::vector<uint16_t> received;
+
+static void deliver(uint8_t* data, uint16_t size)
+{
+    uint16_t opcode;
+    memcpy(&opcode, data, sizeof(uint16_t));
+    received.push_back(opcode);
+}
+
+static boost::intrusive_ptr<Packet> message(uint16_t opcode, uint16_t size = 0)
+{
+    Packet* packet = Packet::create(opcode);
+    for (uint16_t i = 0; i < size; ++i)
+    {
+        *packet << static_cast<uint8_t>(i);
+    }
+
+    packet->sendBuffer();
+    return packet;
+}
+
+// Sends whatever `from` has to `to`, except those datagrams dropped
+static std::size_t exchange(DatagramSession& from, DatagramSession& to, std::vector<std::size_t> dropped = {})  // NOLINT(whitespace/braces)
+{
+    auto datagrams = from.flush();
+    for (std::size_t i = 0; i < datagrams.size(); ++i)
+    {
+        if (std::find(dropped.begin(), dropped.end(), i) == dropped.end())
+        {
+            REQUIRE(to.receive(datagrams[i]->data(), datagrams[i]->written(), deliver));
+        }
+    }
+
+    return datagrams.size();
+}
+
+SCENARIO("Datagram sessions deliver unreliable and reliable messages", "[datagram]") {
+    GIVEN("Two connected sessions") {
+        TestServer server(12345);
+        DatagramSession server_session;
+        DatagramSession client_session;
+        received.clear();
+
+        WHEN("an unreliable message is lost") {
+            server_session.send(message(0x0001), false);
+            exchange(server_session, client_session, { 0 });  // NOLINT(whitespace/braces)
+            exchange(server_session, client_session);
+
+            THEN("it is never delivered") {
+                REQUIRE(received.empty());
+            }
+        }
+
+        WHEN("reliable messages are lost") {
+            server_session.send(message(0x0001), true);
+            exchange(server_session, client_session, { 0 });  // NOLINT(whitespace/braces)
+
+            server_session.send(message(0x0002), true);
+            exchange(server_session, client_session);
+
+            THEN("later ones wait for them") {
+                REQUIRE(received.empty());
+            }
+
+            for (uint8_t i = 0; i < ReliableResendFlushes; ++i)
+            {
+                exchange(server_session, client_session);
+            }
+
+            THEN("they are resent and delivered in order") {
+                REQUIRE(received == std::vector<uint16_t>{ 0x0001, 0x0002 });  // NOLINT(whitespace/braces)
+            }
+        }
+
+        WHEN("reliable messages are acked") {
+            server_session.send(message(0x0001), true);
+            exchange(server_session, client_session);
+            exchange(client_session, server_session);
+
+            THEN("they are not resent") {
+                for (uint8_t i = 0; i < ReliableResendFlushes; ++i)
+                {
+                    REQUIRE(exchange(server_session, client_session) == 0);
+                }
+
+                REQUIRE(received == std::vector<uint16_t>{ 0x0001 });  // NOLINT(whitespace/braces)
+            }
+        }
+
+        WHEN("a message bigger than a datagram is sent") {
+            server_session.send(message(0x0003, 4000), false);
+
+            THEN("it is split, and delivered once whole") {
+                REQUIRE(exchange(server_session, client_session) > 1);
+                REQUIRE(received == std::vector<uint16_t>{ 0x0003 });  // NOLINT(whitespace/braces)
+            }
+        }
+
+        WHEN("a datagram is received twice") {
+            server_session.send(message(0x0001), false);
+            auto datagrams = server_session.flush();
+            REQUIRE(datagrams.size() == 1);
+
+            REQUIRE(client_session.receive(datagrams[0]->data(), datagrams[0]->written(), deliver));
+            REQUIRE(client_session.receive(datagrams[0]->data(), datagrams[0]->written(), deliver));
+
+            THEN("it is only delivered once") {
+                REQUIRE(received == std::vector<uint16_t>{ 0x0001 });  // NOLINT(whitespace/braces)
+            }
+        }
+
+        WHEN("a datagram is malformed") {
+            uint8_t garbage[] = { 0, 0, 0, 0, 0, 0, 0, 0, 7, 1, 0 };  // NOLINT(whitespace/braces)
+
+            THEN("it is rejected") {
+                REQUIRE_FALSE(client_session.receive(garbage, sizeof(garbage), deliver));
+                REQUIRE(received.empty());
+            }
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/input_entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/bit_stream.hpp>
+#include <io/packet.hpp>
+#include <server/input.hpp>
+
+#include <vector>
+
+
+static Packet* batch(uint32_t sequence, uint64_t tick, uint32_t count, uint8_t size = 2)
+{
+    Packet* packet = Packet::create(InputBatchOpcode);
+    BitWriter writer(packet);
+    writer.writeVarint(sequence);
+    writer.writeVarint(tick);
+    writer.writeVarint(count);
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        writer.writeVarint(i == 0 ? 0 : 1);
+        writer.writeVarint(size);
+        for (uint8_t j = 0; j < size; ++j)
+        {
+            writer.write(sequence + i, 8);
+        }
+    }
+
+    writer.flush();
+    return packet;
+}
+
+SCENARIO("Inputs are applied on their tick, once", "[input]") {
+    GIVEN("A queue with a batch of three inputs") {
+        TestServer server(12345);
+        InputEntity entity(1);
+        InputQueue queue;
+
+        Packet* packet = batch(1, 10, 3);
+        REQUIRE(queue.push(packet, 9));
+        packet->destroy();
+
+        WHEN("the first tick is simulated") {
+            queue.apply(&entity, 10);
+
+            THEN("only its input is applied and acknowledged") {
+                REQUIRE(entity.applied == std::vector<uint32_t>{ 1 });  // NOLINT(whitespace/braces)
+                REQUIRE(queue.applied() == 1);
+
+                Packet* ack = queue.acknowledge();
+                REQUIRE(ack != nullptr);
+                REQUIRE(ack->peek<uint16_t>(0) == InputAckOpcode);
+                REQUIRE(ack->peek<uint32_t>(4) == 1);
+                REQUIRE(ack->peek<uint64_t>(8) == 10);
+                ack->destroy();
+
+                REQUIRE(queue.acknowledge() == nullptr);
+            }
+        }
+
+        WHEN("the batch is resent with one more input") {
+            packet = batch(1, 10, 4);
+            REQUIRE(queue.push(packet, 10));
+            packet->destroy();
+
+            for (uint64_t tick = 10; tick <= 13; ++tick)
+            {
+                queue.apply(&entity, tick);
+            }
+
+            THEN("duplicates are dropped") {
+                REQUIRE(entity.applied == std::vector<uint32_t>{ 1, 2, 3, 4 });  // NOLINT(whitespace/braces)
+                REQUIRE(queue.applied() == 4);
+            }
+        }
+
+        WHEN("inputs arrive too late or too early") {
+            for (uint64_t tick = 10; tick <= 13; ++tick)
+            {
+                queue.apply(&entity, tick);
+            }
+
+            packet = batch(4, 5, 1);
+            REQUIRE(queue.push(packet, 13));
+            packet->destroy();
+
+            packet = batch(5, 100, 1);
+            REQUIRE(queue.push(packet, 13));
+            packet->destroy();
+
+            queue.apply(&entity, 14);
+
+            THEN("late ones are acknowledged but not applied, early ones dropped") {
+                REQUIRE(entity.applied == std::vector<uint32_t>{ 1, 2, 3 });  // NOLINT(whitespace/braces)
+                REQUIRE(queue.applied() == 4);
+
+                queue.apply(&entity, 100);
+                REQUIRE(queue.applied() == 4);
+            }
+        }
+
+        WHEN("a batch is malformed") {
+            packet = batch(4, 11, 1, MaxInputBytes + 1);
+
+            THEN("it is rejected") {
+                REQUIRE(!queue.push(packet, 10));
+            }
+
+            packet->destroy();
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#include <catch2/catch.hpp>
+#include "mocks/connection.hpp"
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/packet.hpp>
+#include <map/cell.hpp>
+#include <map/map.hpp>
+#include <map/map-cluster/cluster.hpp>
+#include <server/client.hpp>
+
+#include <chrono>
+#include <future>
+#include <list>
+#include <thread>
+#include <vector>
+
+
+// Iterates its clients, as any real server would
+class PipelinedServer : public TestServer
+{
+public:
+    using TestServer::TestServer;
+
+    ~PipelinedServer()
+    {
+        stop();
+    }
+
+    void iterateClients(std::function<void(Client* client)> callback) override
+    {
+        for (auto client : clients)
+        {
+            callback(client);
+        }
+    }
+
+    std::vector<Client*> clients;
+};
+
+SCENARIO("Clients get what was cut, then what was delivered", "[pipeline]") {
+    GIVEN("A connected client") {
+        TestServer server(12345);
+        boost::asio::io_service service;
+        Connection connection(service, 1);
+        Client* client = connection.client;
+
+        WHEN("packets are sent around a cut and a delivery") {
+            client->send(Packet::create(0x0001));
+            client->cut();
+            client->send(Packet::create(0x0003));
+            client->deliver({ Packet::create(0x0002) });  // NOLINT(whitespace/braces)
+            client->flush();
+
+            client->cut();
+            client->flush();
+
+            std::thread io([&service]() { service.run(); });
+            auto opcodes = connection.receive(3);
+            io.join();
+            service.reset();
+
+            THEN("broadcasts go behind the tick they belong to, later sends after") {
+                REQUIRE(opcodes == std::vector<uint16_t>{ 0x0001, 0x0002, 0x0003 });  // NOLINT(whitespace/braces)
+            }
+        }
+
+        client->close();
+        service.poll();
+        server.runScheduledOperations();
+    }
+}
+
+SCENARIO("Pipelined servers send each tick while simulating the next", "[pipeline]") {
+    GIVEN("A pipelined server with a client seeing a cell") {
+        constexpr uint16_t Ticks = 8;
+
+        PipelinedServer server(12345);
+        boost::asio::io_service service;
+        Connection connection(service, 1);
+        server.clients.push_back(connection.client);
+
+        Entity entity(2);
+        server.map()->addTo(0, 0, entity.asDefault(), nullptr);
+        server.map()->runScheduledOperations();
+        entity.cell()->subscribe(connection.client);
+
+        // The send thread writes on the client strand
+        std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(service));
+        std::thread io([&service]() { service.run(); });
+
+        server.pipelined(true);
+        REQUIRE(server.pipelined());
+
+        WHEN("every tick sends and broadcasts something") {
+            for (uint16_t tick = 0; tick < Ticks; ++tick)
+            {
+                connection.client->send(Packet::create(0x0100 + tick));
+                entity.cell()->broadcast(Packet::create(0x0200 + tick));
+                server.update();
+            }
+
+            // The last stage is sent before it stops
+            server.pipelined(false);
+            auto opcodes = connection.receive(Ticks * 2);
+
+            THEN("ticks arrive whole and in order") {
+                REQUIRE_FALSE(server.pipelined());
+
+                std::vector<uint16_t> expected;
+                for (uint16_t tick = 0; tick < Ticks; ++tick)
+                {
+                    expected.push_back(0x0100 + tick);
+                    expected.push_back(0x0200 + tick);
+                }
+
+                REQUIRE(opcodes == expected);
+            }
+        }
+
+        server.stop();
+        entity.cell()->unsubscribe(connection.client);
+        server.clients.clear();
+
+        work.reset();
+        connection.client->close();
+        io.join();
+        server.runScheduledOperations();
+    }
+}
+
+SCENARIO("Deliveries do not stall the next simulation", "[pipeline]") {
+    GIVEN("A map with an entity and a slow delivery on the cluster pool") {
+        TestServer server(12345);
+        Map* map = server.map();
+
+        Entity entity(1);
+        map->addTo(0, 0, entity.asDefault(), nullptr);
+        map->runScheduledOperations();
+
+        // Posted from the send thread, it only finishes once released
+        std::promise<void> release;
+        std::shared_future<void> released = release.get_future().share();
+        std::future<bool> delivery;
+
+        std::thread sender([map, released, &delivery]()
+            {
+                delivery = map->cluster()->pool()->postWork<bool>([released]()
+                    {
+                        return released.wait_for(std::chrono::seconds(10)) == std::future_status::ready;
+                    }
+                );  // NOLINT(whitespace/parens)
+            }
+        );  // NOLINT(whitespace/parens)
+        sender.join();
+
+        WHEN("the map is updated meanwhile") {
+            map->update(50);
+            map->cleanup(50);
+            release.set_value();
+
+            THEN("it does not wait for the delivery to finish") {
+                REQUIRE(delivery.get());
+            }
+        }
+    }
+}
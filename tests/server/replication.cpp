@@ -0,0 +1,316 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/bit_stream.hpp>
+#include <io/packet.hpp>
+#include <map/map.hpp>
+#include <map/offset.hpp>
+#include <movement/motion_master.hpp>
+#include <server/replication.hpp>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+
+
+struct Decoded
+{
+    uint64_t tick;
+    uint64_t baseline;
+    std::vector<uint64_t> removed;
+    std::map<uint64_t, uint64_t> updates;
+};
+
+static Decoded decode(Packet* packet)
+{
+    Decoded decoded;
+    packet->read<uint16_t>();
+    packet->read<uint16_t>();
+
+    BitReader reader(packet);
+    decoded.tick = reader.readVarint();
+    decoded.baseline = reader.readVarint();
+
+    uint64_t removed = reader.readVarint();
+    for (uint64_t i = 0; i < removed; ++i)
+    {
+        decoded.removed.push_back(reader.readVarint());
+    }
+
+    while (reader.readBool())
+    {
+        uint64_t id = reader.readVarint();
+        uint64_t mask = reader.readVarint();
+        decoded.updates[id] = mask;
+
+        if (mask & (1 << PositionField))
+        {
+            reader.readCellPosition();
+            reader.read(32);
+        }
+        if (mask & (1 << ForwardField))
+        {
+            reader.readAngle();
+        }
+        if (mask & (1 << SpeedField))
+        {
+            reader.read(32);
+        }
+    }
+
+    packet->destroy();
+    return decoded;
+}
+
+SCENARIO("Clients get delta snapshots against their acks", "[replication]") {
+    GIVEN("A few entities around a viewer") {
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        std::list<Entity> list;
+        std::vector<Entity*> entities;
+        for (uint64_t id = 1; id <= 3; ++id)
+        {
+            list.emplace_back(id);
+            auto entity = list.back().asDefault();
+            entity->motionMaster()->teleport({ static_cast<float>(id), 0, 0 });
+            map.addTo(entity, nullptr);
+            entities.push_back(entity);
+        }
+        map.runScheduledOperations();
+
+        Replication replication;
+        const uint16_t all = (1 << UserField) - 1;
+
+        server.update();
+        auto first = decode(replication.snapshot(entities[0], server.tick()));
+
+        WHEN("nothing has been acknowledged") {
+            THEN("snapshots are full") {
+                REQUIRE(first.baseline == 0);
+                REQUIRE(first.updates.size() == 3);
+                REQUIRE(first.updates[2] == all);
+
+                server.update();
+                auto second = decode(replication.snapshot(entities[0], server.tick()));
+                REQUIRE(second.baseline == 0);
+                REQUIRE(second.updates.size() == 3);
+            }
+        }
+
+        WHEN("a snapshot is acknowledged") {
+            replication.ack(first.tick);
+
+            server.update();
+            entities[1]->motionMaster()->teleport({ 20, 0, 0 });  // NOLINT(whitespace/braces)
+
+            map.removeFrom(entities[2], nullptr);
+            map.runScheduledOperations();
+
+            auto delta = decode(replication.snapshot(entities[0], server.tick()));
+
+            THEN("only dirty fields and removals are sent") {
+                REQUIRE(delta.baseline == first.tick);
+                REQUIRE(delta.updates.size() == 1);
+                REQUIRE(delta.updates[2] == (1 << PositionField));
+                REQUIRE(delta.removed == std::vector<uint64_t>{ 3 });  // NOLINT(whitespace/braces)
+            }
+
+            THEN("later snapshots are still relative to the acknowledged one") {
+                server.update();
+                auto next = decode(replication.snapshot(entities[0], server.tick()));
+                REQUIRE(next.baseline == first.tick);
+                REQUIRE(next.updates.size() == 1);
+                REQUIRE(next.removed.size() == 1);
+            }
+        }
+
+        WHEN("the budget fits a single update per tick") {
+            replication.budget(1);
+
+            server.update();
+            auto second = decode(replication.snapshot(entities[0], server.tick()));
+
+            server.update();
+            auto third = decode(replication.snapshot(entities[0], server.tick()));
+
+            server.update();
+            auto fourth = decode(replication.snapshot(entities[0], server.tick()));
+
+            THEN("closest entities go first and deferred ones catch up") {
+                REQUIRE(second.updates.size() == 1);
+                REQUIRE(second.updates.count(1) == 1);
+                REQUIRE(third.updates.size() == 1);
+                REQUIRE(third.updates.count(2) == 1);
+                REQUIRE(fourth.updates.size() == 1);
+                REQUIRE(fourth.updates.count(3) == 1);
+            }
+        }
+
+        WHEN("a deferred entity leaves before its turn") {
+            replication.budget(1);
+
+            server.update();
+            auto second = decode(replication.snapshot(entities[0], server.tick()));
+            REQUIRE(second.updates.count(1) == 1);
+
+            entities[2]->motionMaster()->teleport({ 10000, 0, 10000 });  // NOLINT(whitespace/braces)
+            map.onMove(entities[2]);
+            map.runScheduledOperations();
+
+            server.update();
+            auto third = decode(replication.snapshot(entities[0], server.tick()));
+
+            server.update();
+            auto fourth = decode(replication.snapshot(entities[0], server.tick()));
+
+            THEN("it is never sent, and the rest still catch up") {
+                REQUIRE(third.updates.size() == 1);
+                REQUIRE(third.updates.count(2) == 1);
+                REQUIRE(third.removed.empty());
+                REQUIRE(fourth.updates.count(3) == 0);
+                REQUIRE(fourth.removed.empty());
+            }
+        }
+
+        WHEN("a known entity is left out and then moves away") {
+            replication.ack(first.tick);
+            replication.budget(1);
+
+            server.update();
+            entities[1]->motionMaster()->teleport({ 2, 0, 1 });  // NOLINT(whitespace/braces)
+            entities[2]->motionMaster()->teleport({ 3, 0, 1 });  // NOLINT(whitespace/braces)
+
+            auto truncated = decode(replication.snapshot(entities[0], server.tick()));
+            REQUIRE(truncated.updates.size() == 1);
+            REQUIRE(truncated.updates.count(2) == 1);
+            replication.ack(truncated.tick);
+
+            THEN("it still gets its pending fields later") {
+                server.update();
+                auto next = decode(replication.snapshot(entities[0], server.tick()));
+                REQUIRE(next.baseline == truncated.tick);
+                REQUIRE(next.updates.size() == 1);
+                REQUIRE(next.updates[3] == (1 << PositionField));
+            }
+
+            THEN("its removal still arrives") {
+                server.update();
+                entities[2]->motionMaster()->teleport({ 10000, 0, 10000 });  // NOLINT(whitespace/braces)
+                map.onMove(entities[2]);
+                map.runScheduledOperations();
+
+                auto next = decode(replication.snapshot(entities[0], server.tick()));
+                REQUIRE(next.baseline == truncated.tick);
+                REQUIRE(next.removed == std::vector<uint64_t>{ 3 });  // NOLINT(whitespace/braces)
+            }
+        }
+
+        WHEN("the viewer sees further than its siblings") {
+            list.emplace_back(4);
+            auto far = list.back().asDefault();
+            auto center = Offset(2, 0).center();
+            far->motionMaster()->teleport({ center.x, 0, center.y });
+            map.addTo(far, nullptr);
+            map.runScheduledOperations();
+
+            server.update();
+            auto near = decode(replication.snapshot(entities[0], server.tick()));
+
+            entities[0]->viewRadius(2);
+            map.removeFrom(entities[0], nullptr);
+            map.runScheduledOperations();
+            map.addTo(entities[0], nullptr);
+            map.runScheduledOperations();
+
+            server.update();
+            auto wide = decode(replication.snapshot(entities[0], server.tick()));
+
+            THEN("snapshots follow its view radius") {
+                REQUIRE(near.updates.count(4) == 0);
+                REQUIRE(wide.updates.count(4) == 1);
+            }
+        }
+
+        WHEN("an unknown snapshot is acknowledged") {
+            replication.ack(first.tick + 100);
+
+            server.update();
+            auto full = decode(replication.snapshot(entities[0], server.tick()));
+
+            THEN("the client gets a full one") {
+                REQUIRE(full.baseline == 0);
+                REQUIRE(full.updates.size() == 3);
+            }
+        }
+    }
+}
+
+SCENARIO("Removals are spread over several snapshots", "[replication]") {
+    GIVEN("A viewer knowing more entities than a snapshot can remove") {
+        constexpr uint64_t Count = MaxSnapshotRemovals + 100;
+
+        TestServer server(12345);
+        Map& map = *server.map();
+
+        std::list<Entity> list;
+        for (uint64_t id = 1; id <= Count + 1; ++id)
+        {
+            list.emplace_back(id);
+            auto entity = list.back().asDefault();
+            entity->motionMaster()->teleport({ static_cast<float>(id % 8), 0, static_cast<float>(id % 5) });  // NOLINT(whitespace/braces)
+            map.addTo(entity, nullptr);
+        }
+        map.runScheduledOperations();
+
+        Entity* viewer = &list.back();
+        Replication replication;
+        replication.budget(MaxSnapshotBytes);
+
+        // Acked until everything around is known
+        std::size_t known = 0;
+        while (true)
+        {
+            server.update();
+            auto snapshot = decode(replication.snapshot(viewer, server.tick()));
+            replication.ack(snapshot.tick);
+            if (snapshot.updates.empty())
+            {
+                break;
+            }
+            known += snapshot.updates.size();
+        }
+        REQUIRE(known == Count + 1);
+
+        WHEN("the viewer goes away from all of them") {
+            viewer->motionMaster()->teleport({ 10000, 0, 10000 });  // NOLINT(whitespace/braces)
+            map.onMove(viewer);
+            map.runScheduledOperations();
+
+            server.update();
+            Packet* packet = replication.snapshot(viewer, server.tick());
+            uint16_t maxSize = Packet::MaxSize;
+            REQUIRE(packet->written() <= maxSize);
+
+            auto first = decode(packet);
+            replication.ack(first.tick);
+
+            server.update();
+            auto second = decode(replication.snapshot(viewer, server.tick()));
+
+            THEN("they are removed over two snapshots, once each") {
+                REQUIRE(first.removed.size() == MaxSnapshotRemovals);
+                REQUIRE(second.baseline == first.tick);
+                REQUIRE(second.removed.size() == Count - MaxSnapshotRemovals);
+
+                std::vector<uint64_t> all(first.removed);
+                all.insert(all.end(), second.removed.begin(), second.removed.end());
+                std::sort(all.begin(), all.end());
+                REQUIRE(std::unique(all.begin(), all.end()) == all.end());
+                REQUIRE(all.size() == Count);
+            }
+        }
+    }
+}
@@ -0,0 +1,395 @@
+#include <catch2/catch.hpp>
+#include "mocks/entity.hpp"
+#include "mocks/input_entity.hpp"
+#include "mocks/server.hpp"
+
+#include <io/bit_stream.hpp>
+#include <io/packet.hpp>
+#include <server/client.hpp>
+#include <server/epoll_transport.hpp>
+#include <server/input.hpp>
+#include <server/replication.hpp>
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+
+// Echoes every frame back, sending them once per loop as a tick would
+class LoopbackServer : public TestServer
+{
+public:
+    using TestServer::TestServer;
+
+    ~LoopbackServer()
+    {
+        stop();
+    }
+
+    void handleAccept(Client* client, const boost::system::error_code& error) override
+    {
+        client->startReading();
+        clients.push_back(client);
+    }
+
+    void handleFrame(Client* client, Packet* packet) override
+    {
+        Packet* echo = Packet::create(packet->peek<uint16_t>(0), packet->size() - sizeof(uint16_t) * 2);
+        *echo << packet;
+        client->send(echo);
+        ++echoed;
+    }
+
+    std::vector<Client*> clients;
+    std::atomic<uint64_t> echoed { 0 };  // NOLINT(whitespace/braces)
+};
+
+constexpr uint16_t LoopbackPort = 12345;
+constexpr uint16_t LoopbackPayload = 32;
+
+// Runs the server loop until `done`, or for 30 seconds at most
+static void pump(LoopbackServer& server, const std::atomic<bool>& done)
+{
+    auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::seconds(30);
+    while (!done && std::chrono::high_resolution_clock::now() < deadline)
+    {
+        server.runScheduledOperations();
+        for (auto client : server.clients)
+        {
+            client->cut();
+            client->flush();
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Sends frames of several sizes a few bytes at a time, thus headers and
+// payloads are split across reads. Returns what was echoed back.
+static std::vector<uint8_t> fragmented(LoopbackServer& server, const std::vector<uint8_t>& out)
+{
+    using tcp = boost::asio::ip::tcp;
+
+    std::atomic<bool> done { false };  // NOLINT(whitespace/braces)
+    std::vector<uint8_t> in(out.size());
+
+    std::thread generator([&]()
+        {
+            boost::asio::io_service service;
+            tcp::socket socket(service);
+            socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LoopbackPort));
+            socket.set_option(tcp::no_delay(true));
+
+            for (std::size_t i = 0; i < out.size(); i += 3)
+            {
+                boost::asio::write(socket, boost::asio::buffer(out.data() + i, std::min<std::size_t>(3, out.size() - i)));
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+
+            boost::system::error_code error;
+            boost::asio::read(socket, boost::asio::buffer(in), error);
+            done = true;
+        }
+    );  // NOLINT(whitespace/parens)
+
+    pump(server, done);
+    generator.join();
+    return in;
+}
+
+static std::vector<uint8_t> frames(std::vector<uint16_t> sizes)
+{
+    std::vector<uint8_t> out;
+    for (uint16_t size : sizes)
+    {
+        uint16_t header[] = { static_cast<uint16_t>(0x0100 + size), size };  // NOLINT(whitespace/braces)
+        out.insert(out.end(), reinterpret_cast<uint8_t*>(header), reinterpret_cast<uint8_t*>(header) + sizeof(header));
+        for (uint16_t i = 0; i < size; ++i)
+        {
+            out.push_back(static_cast<uint8_t>(size + i));
+        }
+    }
+
+    return out;
+}
+
+// Connects `connections` sockets, each sending `frames` frames and reading
+// them back, while the server loop runs. Returns the seconds it took.
+static double loopback(LoopbackServer& server, uint16_t connections, uint32_t frames)
+{
+    using tcp = boost::asio::ip::tcp;
+
+    constexpr std::size_t FrameSize = sizeof(uint16_t) * 2 + LoopbackPayload;
+    std::atomic<bool> done { false };  // NOLINT(whitespace/braces)
+    std::atomic<uint64_t> received { 0 };  // NOLINT(whitespace/braces)
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::thread generator([&]()
+        {
+            boost::asio::io_service service;
+            std::vector<std::unique_ptr<tcp::socket>> sockets;
+            tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), LoopbackPort);
+
+            std::vector<uint8_t> out(FrameSize * frames);
+            for (uint32_t i = 0; i < frames; ++i)
+            {
+                uint16_t header[] = { 0x0001, LoopbackPayload };  // NOLINT(whitespace/braces)
+                memcpy(out.data() + i * FrameSize, header, sizeof(header));
+            }
+
+            for (uint16_t i = 0; i < connections; ++i)
+            {
+                sockets.emplace_back(new tcp::socket(service));
+                sockets.back()->connect(endpoint);
+                boost::asio::write(*sockets.back(), boost::asio::buffer(out));
+            }
+
+            std::vector<uint8_t> in(FrameSize * frames);
+            for (auto& socket : sockets)
+            {
+                boost::system::error_code error;
+                received += boost::asio::read(*socket, boost::asio::buffer(in), error);
+            }
+
+            done = true;
+        }
+    );  // NOLINT(whitespace/parens)
+
+    pump(server, done);
+    generator.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    REQUIRE(received == FrameSize * frames * connections);
+    REQUIRE(server.echoed == uint64_t{ frames } * connections);  // NOLINT(whitespace/braces)
+
+    return elapsed;
+}
+
+SCENARIO("Transports echo frames over loopback", "[transport]") {
+    GIVEN("The asio transport") {
+        LoopbackServer server(LoopbackPort);
+        server.startIO(2);
+        server.startAccept();
+
+        THEN("every frame goes back and forth") {
+            loopback(server, 8, 64);
+        }
+    }
+
+#ifdef __linux__
+    GIVEN("The epoll transport") {
+        LoopbackServer server(LoopbackPort);
+        server.transport(new EpollTransport(2));
+        server.startAccept();
+
+        THEN("every frame goes back and forth") {
+            loopback(server, 8, 64);
+        }
+    }
+#endif
+}
+
+SCENARIO("Transports split frames across partial reads", "[transport]") {
+    auto out = frames({ 0, 1, 5, 300, 2, 0, 64 });  // NOLINT(whitespace/braces)
+
+    GIVEN("The asio transport") {
+        LoopbackServer server(LoopbackPort);
+        server.startIO(2);
+        server.startAccept();
+
+        THEN("every frame is handled whole, in order") {
+            REQUIRE(fragmented(server, out) == out);
+            REQUIRE(server.echoed == 7);
+        }
+    }
+
+#ifdef __linux__
+    GIVEN("The epoll transport") {
+        LoopbackServer server(LoopbackPort);
+        server.transport(new EpollTransport(2));
+        server.startAccept();
+
+        THEN("every frame is handled whole, in order") {
+            REQUIRE(fragmented(server, out) == out);
+            REQUIRE(server.echoed == 7);
+        }
+    }
+#endif
+}
+
+#ifdef __linux__
+SCENARIO("Stopping the epoll transport runs what was queued", "[transport]") {
+    GIVEN("A connected client") {
+        using tcp = boost::asio::ip::tcp;
+
+        LoopbackServer server(LoopbackPort);
+        server.transport(new EpollTransport(2));
+        server.startAccept();
+
+        boost::asio::io_service service;
+        tcp::socket socket(service);
+        socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LoopbackPort));
+
+        auto deadline = std::chrono::high_resolution_clock::now() + std::chrono::seconds(10);
+        while (server.clients.empty() && std::chrono::high_resolution_clock::now() < deadline)
+        {
+            server.runScheduledOperations();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        REQUIRE(server.clients.size() == 1);
+        Client* client = server.clients.front();
+
+        WHEN("it is released right before the transport stops") {
+            client->close();
+            client->release();
+            server.transport()->stop();
+
+            THEN("the release is not lost") {
+                REQUIRE(client->release());
+            }
+
+            server.runScheduledOperations();
+        }
+
+        WHEN("it is released once the transport stopped") {
+            server.transport()->stop();
+            client->close();
+
+            THEN("the release is acknowledged anyway") {
+                client->release();
+                REQUIRE(client->release());
+            }
+
+            server.runScheduledOperations();
+        }
+    }
+}
+#endif
+
+SCENARIO("Malformed engine frames close the client", "[transport]") {
+    using tcp = boost::asio::ip::tcp;
+
+    GIVEN("A snapshot ack without its tick") {
+        LoopbackServer server(LoopbackPort);
+        server.startIO(2);
+        server.startAccept();
+
+        std::atomic<bool> done { false };  // NOLINT(whitespace/braces)
+        boost::system::error_code error;
+
+        std::thread generator([&]()
+            {
+                boost::asio::io_service service;
+                tcp::socket socket(service);
+                socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LoopbackPort));
+
+                uint16_t frame[] = { SnapshotAckOpcode, 2, 0 };  // NOLINT(whitespace/braces)
+                boost::asio::write(socket, boost::asio::buffer(frame));
+
+                uint8_t byte;
+                boost::asio::read(socket, boost::asio::buffer(&byte, 1), error);
+                done = true;
+            }
+        );  // NOLINT(whitespace/parens)
+
+        pump(server, done);
+        generator.join();
+
+        THEN("the connection is closed, without reaching the server") {
+            REQUIRE(error == boost::asio::error::eof);
+            REQUIRE(server.echoed == 0);
+        }
+    }
+}
+
+SCENARIO("Input batches are queued by the client itself", "[transport]") {
+    using tcp = boost::asio::ip::tcp;
+
+    GIVEN("A batch of two inputs followed by a regular frame") {
+        LoopbackServer server(LoopbackPort);
+        server.startIO(2);
+        server.startAccept();
+
+        Packet* packet = Packet::create(InputBatchOpcode);
+        BitWriter writer(packet);
+        writer.writeVarint(1);
+        writer.writeVarint(server.tick());
+        writer.writeVarint(2);
+        for (uint8_t i = 0; i < 2; ++i)
+        {
+            writer.writeVarint(i);
+            writer.writeVarint(1);
+            writer.write(i, 8);
+        }
+        writer.flush();
+        packet->finalize();
+
+        std::vector<uint8_t> out(packet->data(), packet->data() + packet->written());
+        auto echo = frames({ 4 });  // NOLINT(whitespace/braces)
+        out.insert(out.end(), echo.begin(), echo.end());
+        packet->destroy();
+
+        std::atomic<bool> done { false };  // NOLINT(whitespace/braces)
+        std::vector<uint8_t> in(echo.size());
+
+        std::thread generator([&]()
+            {
+                boost::asio::io_service service;
+                tcp::socket socket(service);
+                socket.connect(tcp::endpoint(boost::asio::ip::address_v4::loopback(), LoopbackPort));
+                boost::asio::write(socket, boost::asio::buffer(out));
+
+                // Frames are handled in order, the batch is queued once echoed
+                boost::system::error_code error;
+                boost::asio::read(socket, boost::asio::buffer(in), error);
+                done = true;
+            }
+        );  // NOLINT(whitespace/parens)
+
+        pump(server, done);
+        generator.join();
+
+        THEN("only the regular frame reaches the server") {
+            REQUIRE(in == echo);
+            REQUIRE(server.echoed == 1);
+        }
+
+        THEN("its inputs are applied on their ticks") {
+            REQUIRE(server.clients.size() == 1);
+
+            InputEntity entity(1);
+            server.clients.front()->inputs()->apply(&entity, server.tick() + 1);
+            REQUIRE(entity.applied == std::vector<uint32_t>{ 1, 2 });  // NOLINT(whitespace/braces)
+        }
+    }
+}
+
+SCENARIO("Transports throughput over loopback", "[.][benchmark]") {
+    constexpr uint16_t Connections = 256;
+    constexpr uint32_t Frames = 2000;
+
+    GIVEN("The asio transport") {
+        LoopbackServer server(LoopbackPort);
+        server.startIO(4);
+        server.startAccept();
+
+        double seconds = loopback(server, Connections, Frames);
+        WARN("asio: " << (Connections * Frames / seconds) << " frames/s");
+    }
+
+#ifdef __linux__
+    GIVEN("The epoll transport") {
+        LoopbackServer server(LoopbackPort);
+        server.transport(new EpollTransport(4));
+        server.startAccept();
+
+        double seconds = loopback(server, Connections, Frames);
+        WARN("epoll: " << (Connections * Frames / seconds) << " frames/s");
+    }
+#endif
+}